@@ -17,6 +17,9 @@ class Script {
 
   bool CaughtException();
 
+  // Prints type feedback collected by compiled code (for diagnostics)
+  void PrintFeedback(char* buffer, uint32_t size);
+
  private:
   CompiledScript* script;
 };
@@ -14,6 +14,7 @@ namespace candor {
 struct ScopeSlot;
 class AstNode;
 class AstValue;
+class FeedbackSite;
 
 // Just to simplify future use cases
 typedef List<AstNode*, ZoneObject> AstList;
@@ -64,7 +65,9 @@ class AstNode : public ZoneObject {
                        length_(0),
                        stack_count_(0),
                        context_count_(0),
-                       root_(false) {
+                       root_(false),
+                       feedback_(NULL),
+                       boxed_(NULL) {
   }
 
   virtual ~AstNode() {
@@ -109,6 +112,14 @@ class AstNode : public ZoneObject {
   inline int32_t stack_slots() { return stack_count_; }
   inline int32_t context_slots() { return context_count_; }
 
+  // Type feedback site of node's code in fullgen
+  inline FeedbackSite* feedback() { return feedback_; }
+  inline void feedback(FeedbackSite* feedback) { feedback_ = feedback; }
+
+  // Immortal heap number of number literal, shared by all optimized code
+  inline char* boxed() { return boxed_; }
+  inline void boxed(char* boxed) { boxed_ = boxed; }
+
   // Some node (such as Functions) have context and stack variables
   // SetScope will save that information for future uses in generation
   inline void SetScope(Scope* scope) {
@@ -164,6 +175,9 @@ class AstNode : public ZoneObject {
 
   bool root_;
 
+  FeedbackSite* feedback_;
+  char* boxed_;
+
   AstList children_;
 };
 #undef TYPE_MAPPING_NORMAL
@@ -175,9 +189,13 @@ class AstNode : public ZoneObject {
     V(kSub)\
     V(kDiv)\
     V(kMul)\
+    V(kMod)\
     V(kBAnd)\
     V(kBOr)\
     V(kBXor)\
+    V(kShl)\
+    V(kShr)\
+    V(kUShr)\
     V(kEq)\
     V(kStrictEq)\
     V(kNe)\
@@ -235,6 +253,26 @@ class BinOp : public AstNode {
            p->Print("]");
   }
 
+  inline bool is_logic() {
+    return subtype_ == kLAnd || subtype_ == kLOr;
+  }
+  static inline bool is_compare(BinOpType type) {
+    return type == kEq || type == kStrictEq ||
+           type == kNe || type == kStrictNe ||
+           type == kLt || type == kGt ||
+           type == kLe || type == kGe;
+  }
+  inline bool is_compare() { return is_compare(subtype_); }
+  static inline bool is_math(BinOpType type) {
+    return type == kAdd || type == kSub ||
+           type == kMul || type == kDiv;
+  }
+  inline bool is_math() { return is_math(subtype_); }
+  static inline bool is_bitwise(BinOpType type) {
+    return type == kBAnd || type == kBOr || type == kBXor ||
+           type == kShl || type == kShr || type == kUShr;
+  }
+  inline bool is_bitwise() { return is_bitwise(subtype_); }
   inline BinOpType subtype() { return subtype_; }
 
  protected:
@@ -363,6 +401,7 @@ class FunctionLiteral : public AstNode {
 
     offset_ = offset;
     length_ = 0;
+    global_slots_ = 0;
   }
 
   static inline FunctionLiteral* Cast(AstNode* node) {
@@ -417,8 +456,35 @@ class FunctionLiteral : public AstNode {
   inline void variable(AstNode* variable) { variable_ = variable; }
   inline AstList* args() { return &args_; }
 
+  // Outer contexts used repeatedly are loaded into stack slots after
+  // variables' ones at entry (see Scope::Analyze), display keeps one of
+  // variables looked up in each of them, in ascending order of depth
+  inline List<ScopeSlot*, ZoneObject>* display() { return &display_; }
+  inline void AddDisplay(ScopeSlot* slot) {
+    display_.Push(slot);
+    stack_count_++;
+  }
+
+  // (Root only) number of global variables' cells in root context
+  inline int32_t global_slots() { return global_slots_; }
+  inline void global_slots(int32_t global_slots) {
+    global_slots_ = global_slots;
+  }
+
+  // Returns stack slot of context at `depth`, or -1
+  inline int32_t DisplaySlot(int32_t depth) {
+    int32_t slot = stack_count_ - static_cast<int32_t>(display_.length());
+    List<ScopeSlot*, ZoneObject>::Item* item = display_.head();
+    for (; item != NULL; item = item->next(), slot++) {
+      if (item->value()->depth() == depth) return slot;
+    }
+    return -1;
+  }
+
   AstNode* variable_;
   AstList args_;
+  List<ScopeSlot*, ZoneObject> display_;
+  int32_t global_slots_;
 
   uint32_t offset_;
   uint32_t length_;
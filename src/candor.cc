@@ -30,4 +30,9 @@ bool Script::CaughtException() {
   return script->CaughtException();
 }
 
+
+void Script::PrintFeedback(char* buffer, uint32_t size) {
+  script->PrintFeedback(buffer, size);
+}
+
 } // namespace candor
@@ -2,7 +2,8 @@
 #include "parser.h"
 #include "heap.h"
 #include "fullgen.h"
-#include "utils.h" // GetPageSize
+#include "feedback.h" // FeedbackList
+#include "utils.h" // GetPageSize, PrintBuffer
 
 #include <string.h> // memcpy, memset
 #include <sys/mman.h> // mmap
@@ -31,16 +32,17 @@ void CompiledScript::Compile() {
   // XXX: Hardcoded page size here
   heap_ = new Heap(2 * 1024 * 1024);
 
+  // AST lives in script's zone, optimizing compiler will visit it again
+  Parser p(source_, length_);
+  AstNode* ast = p.Execute();
+
+  // Add scope information to variables (i.e. stack vs context, and indexes)
+  Scope::Analyze(ast);
+
   {
     Zone zone;
-    Parser p(source_, length_);
     Fullgen f(heap_);
 
-    AstNode* ast = p.Execute();
-
-    // Add scope information to variables (i.e. stack vs context, and indexes)
-    Scope::Analyze(ast);
-
     // Generate machine code
     f.Generate(ast);
 
@@ -49,6 +51,11 @@ void CompiledScript::Compile() {
 
     guard_ = new Guard(f.buffer(), f.length());
     f.Relocate(guard_->buffer());
+
+    FeedbackList::Item* item = heap_->feedback()->head();
+    for (; item != NULL; item = item->next()) {
+      item->value()->Relocate(guard_->buffer());
+    }
   }
 }
 
@@ -65,6 +72,17 @@ bool CompiledScript::CaughtException() {
 }
 
 
+void CompiledScript::PrintFeedback(char* buffer, uint32_t size) {
+  PrintBuffer p(buffer, size);
+
+  FeedbackList::Item* item = heap_->feedback()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!item->value()->Print(&p)) break;
+  }
+  p.Finalize();
+}
+
+
 Guard::Guard(char* buffer, uint32_t length) {
   page_size_ = GetPageSize();
 
@@ -45,6 +45,9 @@ class CompiledScript {
 
   bool CaughtException();
 
+  // Prints type feedback of all functions into buffer
+  void PrintFeedback(char* buffer, uint32_t size);
+
  private:
   Zone zone_;
   Heap* heap_;
@@ -0,0 +1,187 @@
+#include "feedback.h"
+#include "compiler.h" // Guard
+#include "utils.h" // List, PrintBuffer
+
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL
+#include <assert.h> // assert
+
+namespace candor {
+
+bool FeedbackSite::Print(PrintBuffer* p) {
+  const char* kind = NULL;
+  switch (kind_) {
+   case kBinOp: kind = "binop"; break;
+   case kMember: kind = "member"; break;
+   case kCall: kind = "call"; break;
+   case kCondition: kind = "cond"; break;
+   default: kind = "?"; break;
+  }
+  if (!p->Print("%s:", kind)) return false;
+
+  bool first = true;
+  if (kind_ == kCall && target_ != 0) {
+    if (!p->Print(is_monomorphic() ? "monomorphic" : "megamorphic")) {
+      return false;
+    }
+    first = false;
+  }
+
+  static const char* names[] = {
+    "smi", "double", "boolean", "nil", "object", "generic"
+  };
+  for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if ((types_ & (1 << i)) == 0) continue;
+    if (!p->Print(first ? "%s" : "|%s", names[i])) return false;
+    first = false;
+  }
+
+  // Site wasn't reached yet
+  if (first) return p->Print("-");
+
+  return true;
+}
+
+
+void FeedbackSite::CallSite(uint32_t call, uint32_t generic) {
+  call_offset_ = call;
+  generic_offset_ = generic;
+}
+
+
+void FeedbackSite::Relocate(char* code) {
+  if (kind_ != kCall || call_offset_ == 0) return;
+
+  call_ = code + call_offset_;
+  generic_ = code + generic_offset_;
+}
+
+
+FeedbackVector::FeedbackVector(AstNode* fn, uint32_t offset, uint32_t length)
+    : fn_(fn),
+      offset_(offset),
+      length_(length),
+      counter_(kHotCalls),
+      code_(NULL),
+      guard_(NULL),
+      osr_counter_(kHotIterations),
+      osr_loop_(NULL),
+      osr_code_(NULL),
+      deoptimized_(false) {
+  sites_.allocated = true;
+  osr_guards_.allocated = true;
+  resume_points_.allocated = true;
+}
+
+
+FeedbackVector::~FeedbackVector() {
+  delete guard_;
+}
+
+
+FeedbackSite* FeedbackVector::AddSite(FeedbackSite::Kind kind) {
+  FeedbackSite* site = new FeedbackSite(kind);
+  sites_.Push(site);
+  return site;
+}
+
+
+FeedbackSite* FeedbackVector::At(uint32_t index) {
+  List<FeedbackSite*, EmptyClass>::Item* item = sites_.head();
+  for (; item != NULL && index > 0; index--) item = item->next();
+
+  return item == NULL ? NULL : item->value();
+}
+
+
+void FeedbackVector::Optimized(Guard* guard, char* code) {
+  assert(guard_ == NULL);
+  guard_ = guard;
+  code_ = code;
+}
+
+
+char* FeedbackVector::OsrCompiled(AstNode* loop, Guard* guard, char* entry) {
+  // Frames that are running older code may still return into it
+  osr_guards_.Push(guard);
+  osr_loop_ = loop;
+  osr_code_ = entry;
+
+  // Next activations of function will enter the same code
+  osr_counter_ = kHotIterations;
+
+  return entry;
+}
+
+
+char* FeedbackVector::OsrEntry(AstNode* loop) {
+  if (osr_loop_ != loop) return NULL;
+
+  osr_counter_ = kHotIterations;
+  return osr_code_;
+}
+
+
+void FeedbackVector::Deoptimized() {
+  code_ = NULL;
+  osr_loop_ = NULL;
+  osr_code_ = NULL;
+  deoptimized_ = true;
+
+  // Speculation has failed once, it'll likely fail again
+  DisableOptimization();
+}
+
+
+void FeedbackVector::AddResumePoint(AstNode* node, uint32_t offset) {
+  Resume* resume = new Resume();
+  resume->node = node;
+  resume->offset = offset;
+  resume->addr = NULL;
+  resume_points_.Push(resume);
+}
+
+
+char* FeedbackVector::ResumePoint(AstNode* node) {
+  List<Resume*, EmptyClass>::Item* item = resume_points_.head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value()->node == node) return item->value()->addr;
+  }
+
+  return NULL;
+}
+
+
+void FeedbackVector::Relocate(char* code) {
+  List<Resume*, EmptyClass>::Item* item = resume_points_.head();
+  for (; item != NULL; item = item->next()) {
+    item->value()->addr = code + item->value()->offset;
+  }
+
+  List<FeedbackSite*, EmptyClass>::Item* site = sites_.head();
+  for (; site != NULL; site = site->next()) site->value()->Relocate(code);
+}
+
+
+void FeedbackVector::ResetFunctions() {
+  List<FeedbackSite*, EmptyClass>::Item* item = sites_.head();
+  for (; item != NULL; item = item->next()) item->value()->ResetFunction();
+}
+
+
+bool FeedbackVector::Print(PrintBuffer* p) {
+  if (!p->Print(code_ == NULL ? "[@%d" : "[@%d optimized", offset_)) {
+    return false;
+  }
+  if (osr_code_ != NULL && !p->Print(" osr")) return false;
+  if (deoptimized_ && !p->Print(" deoptimized")) return false;
+
+  List<FeedbackSite*, EmptyClass>::Item* item = sites_.head();
+  for (; item != NULL; item = item->next()) {
+    if (!p->Print(" ") || !item->value()->Print(p)) return false;
+  }
+
+  return p->Print("]");
+}
+
+} // namespace candor
@@ -0,0 +1,207 @@
+#ifndef _SRC_FEEDBACK_H_
+#define _SRC_FEEDBACK_H_
+
+#include "utils.h" // List, PrintBuffer
+
+#include <stdint.h> // uint8_t, uint32_t, uint64_t
+
+namespace candor {
+
+// Forward declarations
+class AstNode;
+class Guard;
+
+// Profile of one operation in non-optimized code,
+// generated code ORs types it has seen into the site.
+class FeedbackSite {
+ public:
+  enum Kind {
+    kBinOp,
+    kMember,
+    kCall,
+    kCondition
+  };
+
+  // Operand types of binop, receiver types of member lookup and
+  // types of tested values of condition
+  enum Type {
+    // Unboxed numbers (for bitwise ops: operands were truncated inline)
+    kSmi = 0x01,
+    // Heap numbers, or unboxed result that has overflowed
+    kDouble = 0x02,
+    kBoolean = 0x04,
+    kNil = 0x08,
+    kObject = 0x10,
+    // Anything that was handled by stub or runtime
+    kGeneric = 0x20
+  };
+
+  // Call target of site that has seen more than one callee
+  static const uint64_t kMegamorphic = 1;
+
+  // Cached function of call site that has none (misaligned pointer,
+  // so it's never equal to any value)
+  static const uint64_t kNoFunction = 2;
+
+  FeedbackSite(Kind kind) : kind_(kind),
+                            types_(0),
+                            target_(0),
+                            function_(reinterpret_cast<char*>(kNoFunction)),
+                            call_offset_(0),
+                            generic_offset_(0),
+                            call_(NULL),
+                            generic_(NULL) {
+  }
+
+  bool Print(PrintBuffer* p);
+
+  inline Kind kind() { return kind_; }
+  inline uint8_t types() { return types_; }
+  inline bool has(Type type) { return (types_ & type) != 0; }
+
+  // Code address of the only callee seen by call site,
+  // zero if none and kMegamorphic if many
+  inline uint64_t target() { return target_; }
+  inline bool is_monomorphic() {
+    return target_ != 0 && target_ != kMegamorphic;
+  }
+
+  // Monomorphic call site calls callee's code directly, and keeps
+  // the last called function object, so calling it again skips all checks.
+  // `call` is an offset of the end of `call` instruction in fullgen code,
+  // `generic` is an offset of code calling through function object.
+  void CallSite(uint32_t call, uint32_t generic);
+
+  // Turns offsets of call site into addresses once code is relocated
+  void Relocate(char* code);
+
+  // Objects are moved by GC, function is cached again on next call
+  inline void ResetFunction() {
+    function_ = reinterpret_cast<char*>(kNoFunction);
+  }
+
+  // Addresses embedded into generated code
+  inline uint8_t* types_addr() { return &types_; }
+  inline uint64_t* target_addr() { return &target_; }
+  inline char** function_addr() { return &function_; }
+  inline char** call_addr() { return &call_; }
+  inline char** generic_addr() { return &generic_; }
+
+ private:
+  Kind kind_;
+  uint8_t types_;
+  uint64_t target_;
+
+  char* function_;
+  uint32_t call_offset_;
+  uint32_t generic_offset_;
+  char* call_;
+  char* generic_;
+};
+
+// Feedback sites of one function, in order of code generation.
+// AST nodes keep references to their sites (see AstNode::feedback()).
+// Function is identified by it's boundaries in source.
+//
+// Vector also drives tiering: fullgen code decrements `counter` on each
+// call, and once it reaches zero function is compiled by optimizing
+// compiler (see hir.h) and further calls jump into optimized code.
+// Outermost loops decrement `osr_counter` on each iteration, hot loop
+// is compiled with an entry at it's header and running fullgen frame is
+// taken over by optimized code (on-stack replacement).
+//
+// Optimized code that speculates on feedback deoptimizes once it's
+// assumptions fail: it rebuilds fullgen's frame and continues at one of
+// the resume points - function's entry or loop's condition.
+class FeedbackVector {
+ public:
+  // Calls before function is optimized
+  static const int64_t kHotCalls = 1000;
+
+  // Loop iterations before on-stack replacement
+  static const int64_t kHotIterations = 5000;
+
+  FeedbackVector(AstNode* fn, uint32_t offset, uint32_t length);
+  ~FeedbackVector();
+
+  FeedbackSite* AddSite(FeedbackSite::Kind kind);
+
+  // Returns site by it's index, or NULL
+  FeedbackSite* At(uint32_t index);
+
+  bool Print(PrintBuffer* p);
+
+  // Installs optimized code, vector owns it from now on
+  void Optimized(Guard* guard, char* code);
+
+  // Installs code with entry at `loop`'s header, returns entry
+  char* OsrCompiled(AstNode* loop, Guard* guard, char* entry);
+
+  // Returns entry into code compiled for `loop`, or NULL
+  char* OsrEntry(AstNode* loop);
+
+  // Drops optimized code, function will run in fullgen from now on.
+  // Guards are kept, deoptimizing frame is still leaving their code.
+  void Deoptimized();
+
+  // Function will never be optimized
+  inline void DisableOptimization() {
+    counter_ = -1;
+    osr_counter_ = -1;
+  }
+
+  // Offset of fullgen code where deoptimized code continues
+  // (`node` is a function or a loop)
+  void AddResumePoint(AstNode* node, uint32_t offset);
+
+  // Returns address of resume point, or NULL
+  char* ResumePoint(AstNode* node);
+
+  // Turns offsets of resume points and call sites into addresses once
+  // code is relocated
+  void Relocate(char* code);
+
+  // Drops function objects cached by call sites
+  void ResetFunctions();
+
+  inline AstNode* fn() { return fn_; }
+  inline uint32_t offset() { return offset_; }
+  inline uint32_t length() { return length_; }
+  inline List<FeedbackSite*, EmptyClass>* sites() { return &sites_; }
+  inline char* code() { return code_; }
+
+  // Addresses embedded into generated code
+  inline int64_t* counter_addr() { return &counter_; }
+  inline char** code_addr() { return &code_; }
+  inline int64_t* osr_counter_addr() { return &osr_counter_; }
+
+ private:
+  AstNode* fn_;
+  uint32_t offset_;
+  uint32_t length_;
+  List<FeedbackSite*, EmptyClass> sites_;
+
+  int64_t counter_;
+  char* code_;
+  Guard* guard_;
+
+  int64_t osr_counter_;
+  AstNode* osr_loop_;
+  char* osr_code_;
+  List<Guard*, EmptyClass> osr_guards_;
+
+  bool deoptimized_;
+
+  struct Resume {
+    AstNode* node;
+    uint32_t offset;
+    char* addr;
+  };
+  List<Resume*, EmptyClass> resume_points_;
+};
+
+typedef List<FeedbackVector*, EmptyClass> FeedbackList;
+
+} // namespace candor
+
+#endif // _SRC_FEEDBACK_H_
@@ -5,6 +5,7 @@
 #include "ast.h" // AstNode, FunctionLiteral
 #include "zone.h" // ZoneObject
 #include "utils.h" // List
+#include "feedback.h" // FeedbackVector, FeedbackSite
 
 #if __ARCH == x64
 #include "x64/macroassembler-x64.h"
@@ -70,6 +71,20 @@ class FAstOperand : public AstValue {
   Operand* op_;
 };
 
+// Root context's slot of literal, literals with the same source share it
+class FLiteral : public ZoneObject {
+ public:
+  FLiteral(int32_t index) : index_(index) {
+  }
+
+  inline int32_t index() { return index_; }
+
+ protected:
+  int32_t index_;
+};
+
+typedef HashMap<FLiteral*, ZoneObject> FLiteralMap;
+
 // Generates non-optimized code by visiting each node in AST tree in-order
 class Fullgen : public Masm, public Visitor {
  public:
@@ -77,11 +92,13 @@ class Fullgen : public Masm, public Visitor {
    public:
     CandorFunction(Fullgen* fullgen, FunctionLiteral* fn) : FFunction(fullgen),
                                                             fullgen_(fullgen),
-                                                            fn_(fn) {
+                                                            fn_(fn),
+                                                            feedback_(NULL) {
     }
 
     inline Fullgen* fullgen() { return fullgen_; }
     inline FunctionLiteral* fn() { return fn_; }
+    inline FeedbackVector* feedback() { return feedback_; }
 
     static inline CandorFunction* Cast(void* value) {
       return reinterpret_cast<CandorFunction*>(value);
@@ -92,6 +109,7 @@ class Fullgen : public Masm, public Visitor {
    protected:
     Fullgen* fullgen_;
     FunctionLiteral* fn_;
+    FeedbackVector* feedback_;
   };
 
   enum VisitorType {
@@ -106,8 +124,22 @@ class Fullgen : public Masm, public Visitor {
   void GeneratePrologue(AstNode* stmt);
   void GenerateEpilogue(AstNode* stmt);
 
-  // Stores reference to HValue inside root context
-  void PlaceInRoot(char* addr);
+  // Function's entry checks arguments count (see Masm::kFastEntryOffset),
+  // adaptor passes nil instead of missing register arguments
+  void GenerateEntry(AstNode* stmt, Label* adaptor, Label* fast);
+  void GenerateAdaptor(AstNode* stmt, Label* adaptor, Label* fast);
+
+  // Jumps into optimized code of function if it's hot (see FeedbackVector)
+  void GenerateTierUp();
+
+  // Continues in optimized code at `loop`'s header if loop is hot
+  void GenerateOsr(AstNode* loop);
+
+  // Stores reference to HValue inside root context, returns it's index
+  int32_t PlaceInRoot(char* addr);
+
+  // Loads HValue from root context into result()
+  void LoadRoot(int32_t index);
 
   // Alloctes HContext object for root variables
   char* AllocateRoot();
@@ -125,7 +157,11 @@ class Fullgen : public Masm, public Visitor {
   AstNode* VisitString(AstNode* node);
   AstNode* VisitProperty(AstNode* node);
 
-  void ConvertToBoolean();
+  // Jumps to `is_true` or `is_false` depending on truthiness of result(),
+  // type of value is recorded into `site` if it's not NULL
+  void BranchOnValue(Label* is_true,
+                     Label* is_false,
+                     FeedbackSite* site = NULL);
 
   AstNode* VisitIf(AstNode* node);
   AstNode* VisitWhile(AstNode* node);
@@ -140,8 +176,33 @@ class Fullgen : public Masm, public Visitor {
   AstNode* VisitBinOp(AstNode* node);
 
   AstNode* VisitForValue(AstNode* node, Register reg);
+
+  // Same as above, but arithmetic node may put it's double result into
+  // heap()->double_box(double_box) instead of allocating new heap number,
+  // or into heap number held by `stack_box` slot (see ScopeSlot)
+  AstNode* VisitForValue(AstNode* node,
+                         Register reg,
+                         int32_t double_box,
+                         int32_t stack_box = -1);
+
+  // Visits operand of binop, which will be consumed right away.
+  // So slots' mutable boxes are loaded as is, without copying
+  AstNode* VisitForOperand(AstNode* node, Register reg, int32_t double_box);
   AstNode* VisitForSlot(AstNode* node, Operand* op, Register base);
 
+  // Evaluates expression only to branch on it's result,
+  // NULL label means falling through in that case
+  void VisitForControl(AstNode* node, Label* is_true, Label* is_false);
+  void VisitCompareForControl(BinOp* op, Label* is_true, Label* is_false);
+
+  // Puts `true` or `false` into result() depending on expression's value
+  void VisitForBoolean(AstNode* node);
+
+  // Adds feedback site to the function being generated
+  inline FeedbackSite* AddSite(FeedbackSite::Kind kind) {
+    return current_function()->feedback()->AddSite(kind);
+  }
+
   inline Heap* heap() { return heap_; }
   inline bool visiting_for_value() { return visitor_type_ == kValue; }
   inline bool visiting_for_slot() { return visitor_type_ == kSlot; }
@@ -153,9 +214,18 @@ class Fullgen : public Masm, public Visitor {
  private:
   Heap* heap_;
   VisitorType visitor_type_;
+  int32_t double_box_;
+  int32_t stack_box_;
+  FeedbackSite* condition_site_;
+  int32_t loop_depth_;
+  bool tail_call_;
   List<FFunction*, ZoneObject> fns_;
   CandorFunction* current_function_;
   List<char*, ZoneObject> root_context_;
+
+  // Constant pool, strings and heap numbers are kept apart (see FLiteral)
+  FLiteralMap strings_;
+  FLiteralMap numbers_;
 };
 
 } // namespace candor
@@ -1,5 +1,6 @@
 #include "gc.h"
 #include "heap.h"
+#include "feedback.h" // FeedbackList
 
 #include <sys/types.h> // off_t
 #include <assert.h> // assert
@@ -44,6 +45,9 @@ void GC::CollectGarbage(char* stack_top) {
     // Skip unboxed address
     if (HValue::IsUnboxed(value->value()->addr())) continue;
 
+    // Immortal objects are living in old space and are never moved
+    if (value->value()->IsImmortal()) continue;
+
     if (!value->value()->IsGCMarked()) {
       HValue* hvalue = value->value()->CopyTo(&space);
       value->Relocate(hvalue->addr());
@@ -54,12 +58,20 @@ void GC::CollectGarbage(char* stack_top) {
     }
   }
 
+  // String table and number cache don't keep runtime strings alive
+  heap()->string_table()->Sweep();
+  heap()->SweepNumberStrings();
+
   // Remove marks on finish
   while (black_items()->length() != 0) {
     black_items()->Shift()->ResetGCMark();
   }
 
   heap()->new_space()->Swap(&space);
+
+  // Call sites compare functions by address, and they have moved
+  FeedbackList::Item* item = heap()->feedback()->head();
+  for (; item != NULL; item = item->next()) item->value()->ResetFunctions();
 }
 
 
@@ -106,17 +118,36 @@ void GC::VisitFunction(HFunction* fn) {
 
 
 void GC::VisitObject(HObject* obj) {
-  grey_items()->Push(new GCValue(HValue::New(obj->map()), obj->map_slot()));
+  if (obj->HasMap()) {
+    grey_items()->Push(new GCValue(HValue::New(obj->map()), obj->map_slot()));
+    return;
+  }
+
+  // Every inline entry is a key and a value
+  for (uint32_t i = 0; i < HObject::kInlineProperties << 1; i += 2) {
+    if (obj->IsEmptySlot(i)) continue;
+    grey_items()->Push(new GCValue(obj->GetSlot(i),
+                                   obj->GetSlotAddress(i)));
+
+    // Value may be nil
+    if (obj->IsEmptySlot(i + 1)) continue;
+    grey_items()->Push(new GCValue(obj->GetSlot(i + 1),
+                                   obj->GetSlotAddress(i + 1)));
+  }
 }
 
 
 void GC::VisitMap(HMap* map) {
-  for (uint32_t i = 0; i < map->size(); i++) {
+  // Every entry is a key and a value
+  for (uint32_t i = 0; i < map->size() << 1; i += 2) {
     if (map->IsEmptySlot(i)) continue;
     grey_items()->Push(new GCValue(map->GetSlot(i),
                                    map->GetSlotAddress(i)));
-    grey_items()->Push(new GCValue(map->GetSlot(i + map->size()),
-                                   map->GetSlotAddress(i + map->size())));
+
+    // Value may be nil
+    if (map->IsEmptySlot(i + 1)) continue;
+    grey_items()->Push(new GCValue(map->GetSlot(i + 1),
+                                   map->GetSlotAddress(i + 1)));
   }
 }
 
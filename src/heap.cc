@@ -65,11 +65,22 @@ void Space::Swap(Space* space) {
   // Remove self pages
   Clear();
 
+  uint32_t used = 0;
   while (space->pages_.length() != 0) {
-    pages_.Push(space->pages_.Shift());
+    Page* page = space->pages_.Shift();
+    used += page->top_ - page->data_;
+    pages_.Push(page);
   }
 
-  select(pages_.head()->value());
+  // Pages before the last one were filled by copying, and GC runs again
+  // once the last one is exhausted. Leave at least as much free space as
+  // survived, otherwise large heaps would be collected over and over.
+  Page* last = pages_.tail()->value();
+  if (static_cast<uint32_t>(last->limit_ - last->top_) < used) {
+    last = new Page(RoundUp(used, page_size_));
+    pages_.Push(last);
+  }
+  select(last);
 }
 
 
@@ -80,6 +91,129 @@ void Space::Clear() {
 }
 
 
+StringTable::StringTable(Heap* heap) : heap_(heap), size_(64), count_(0) {
+  entries_ = new char*[size_];
+  memset(entries_, 0, size_ * sizeof(*entries_));
+}
+
+
+StringTable::~StringTable() {
+  delete[] entries_;
+}
+
+
+char* StringTable::Intern(const char* value,
+                          uint32_t length,
+                          bool immortal) {
+  uint32_t hash = ComputeHash(value, length, heap()->hash_seed());
+  char** entry = Find(value, length, hash);
+  if (*entry != NULL) {
+    // Fullgen creates symbols for every literal before any code runs,
+    // so runtime can't intern their contents first
+    assert(!immortal || HValue::IsImmortal(*entry));
+    return *entry;
+  }
+
+  // hash(8) + length(8) + bytes
+  char* result;
+  if (immortal) {
+    result = heap()->AllocateImmortal(Heap::kTagString, length + 16);
+  } else {
+    // NOTE: Runtime callers hold raw pointers to objects, so no GC here
+    result = heap()->AllocateTagged(Heap::kTagString, length + 16, NULL);
+  }
+  *reinterpret_cast<uint64_t*>(result + 8) = hash;
+  *reinterpret_cast<uint64_t*>(result + 16) = length;
+  memcpy(result + 24, value, length);
+
+  *entry = result;
+
+  // Keep table at most half-full
+  if (++count_ > (size_ >> 1)) Grow();
+
+  return result;
+}
+
+
+char* StringTable::Intern(char* str) {
+  // Immortal strings are always interned
+  if (HValue::IsImmortal(str)) return str;
+
+  return Intern(str + 24, *reinterpret_cast<uint32_t*>(str + 16), false);
+}
+
+
+char* StringTable::Lookup(const char* value, uint32_t length, uint32_t hash) {
+  return *Find(value, length, hash);
+}
+
+
+char** StringTable::Find(const char* value, uint32_t length, uint32_t hash) {
+  uint32_t mask = size_ - 1;
+  uint32_t index = hash & mask;
+
+  while (entries_[index] != NULL) {
+    char* entry = entries_[index];
+    if (*reinterpret_cast<uint32_t*>(entry + 8) == hash &&
+        *reinterpret_cast<uint32_t*>(entry + 16) == length &&
+        memcmp(entry + 24, value, length) == 0) {
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+
+  return &entries_[index];
+}
+
+
+void StringTable::Grow() {
+  Rehash(size_ << 1);
+}
+
+
+void StringTable::Sweep() {
+  uint32_t removed = 0;
+  for (uint32_t i = 0; i < size_; i++) {
+    char* entry = entries_[i];
+    if (entry == NULL || HValue::IsImmortal(entry)) continue;
+
+    HValue value(entry);
+    if (value.IsGCMarked()) {
+      entries_[i] = value.GetGCMark();
+    } else {
+      entries_[i] = NULL;
+      removed++;
+    }
+  }
+  if (removed == 0) return;
+
+  // Removed entries may have broken probe sequences
+  count_ -= removed;
+  Rehash(size_);
+}
+
+
+void StringTable::Rehash(uint32_t size) {
+  char** old = entries_;
+  uint32_t old_size = size_;
+
+  size_ = size;
+  entries_ = new char*[size_];
+  memset(entries_, 0, size_ * sizeof(*entries_));
+
+  for (uint32_t i = 0; i < old_size; i++) {
+    char* entry = old[i];
+    if (entry == NULL) continue;
+
+    uint32_t index = *reinterpret_cast<uint32_t*>(entry + 8) & (size_ - 1);
+    while (entries_[index] != NULL) index = (index + 1) & (size_ - 1);
+    entries_[index] = entry;
+  }
+
+  delete[] old;
+}
+
+
 char* Heap::AllocateTagged(HeapTag tag, uint32_t bytes, char* stack_top) {
   char* result = new_space()->Allocate(bytes + 8, stack_top);
   *reinterpret_cast<uint64_t*>(result) = tag;
@@ -88,6 +222,39 @@ char* Heap::AllocateTagged(HeapTag tag, uint32_t bytes, char* stack_top) {
 }
 
 
+char* Heap::AllocateImmortal(HeapTag tag, uint32_t bytes) {
+  // Old space is never collected, so there's no need in stack_top
+  char* result = old_space()->Allocate(bytes + 8, NULL);
+  *reinterpret_cast<uint64_t*>(result) = tag | kImmortalBit;
+
+  return result;
+}
+
+
+void Heap::SweepNumberStrings() {
+  for (uint32_t i = 0; i < kNumberStringCacheSize << 1; i += 2) {
+    char* str = number_string_cache_[i + 1];
+    if (str == NULL || HValue::IsImmortal(str)) continue;
+
+    HValue value(str);
+    if (value.IsGCMarked()) {
+      number_string_cache_[i + 1] = value.GetGCMark();
+    } else {
+      number_string_cache_[i] = NULL;
+      number_string_cache_[i + 1] = NULL;
+    }
+  }
+}
+
+
+char* Heap::AllocateBoolean(bool value) {
+  char* result = AllocateImmortal(kTagBoolean, 8);
+  *reinterpret_cast<int8_t*>(result + 8) = value ? 1 : 0;
+
+  return result;
+}
+
+
 Heap::HeapTag HValue::GetTag(char* addr) {
   if (addr == NULL) return Heap::kTagNil;
 
@@ -103,6 +270,12 @@ bool HValue::IsUnboxed(char* addr) {
 }
 
 
+bool HValue::IsImmortal(char* addr) {
+  if (addr == NULL || IsUnboxed(addr)) return false;
+  return (*reinterpret_cast<uint64_t*>(addr) & Heap::kImmortalBit) != 0;
+}
+
+
 HValue::HValue(char* addr) : addr_(addr) {
   tag_ = HValue::GetTag(addr);
 }
@@ -156,11 +329,12 @@ HValue* HValue::CopyTo(Space* space) {
     size += 16 + As<HString>()->length();
     break;
    case Heap::kTagObject:
-    // mask + map
+    // mask + map (+ inline entries)
     size += 16;
+    if (!As<HObject>()->HasMap()) size += HObject::kInlineProperties << 4;
     break;
    case Heap::kTagMap:
-    // size + space ( keys + values )
+    // size + count + entries ( key + value )
     size += 8 + (As<HMap>()->size() << 4);
     break;
    default:
@@ -192,6 +366,11 @@ void HValue::SetGCMark(char* new_addr) {
 }
 
 
+bool HValue::IsImmortal() {
+  return IsImmortal(addr());
+}
+
+
 void HValue::ResetGCMark() {
   if (IsGCMarked()) {
     *reinterpret_cast<uint64_t*>(addr()) ^= 0x80000000;
@@ -271,7 +450,7 @@ char* HNumber::New(Heap* heap, char* stack_top, double value) {
 }
 
 
-uint64_t HNumber::Untag(uint64_t value) {
+int64_t HNumber::Untag(int64_t value) {
   return value >> 1;
 }
 
@@ -287,10 +466,8 @@ HBoolean::HBoolean(char* addr) : HValue(addr) {
 
 
 char* HBoolean::New(Heap* heap, char* stack_top, bool value) {
-  char* result = heap->AllocateTagged(Heap::kTagBoolean, 8, stack_top);
-  *reinterpret_cast<int8_t*>(result + 8) = value ? 1 : 0;
-
-  return result;
+  // Booleans are never allocated, use singletons instead
+  return value ? heap->true_value() : heap->false_value();
 }
 
 
@@ -302,7 +479,7 @@ HString::HString(char* addr) : HValue(addr) {
   uint32_t* hash_addr = reinterpret_cast<uint32_t*>(addr + 8);
   hash_ = *hash_addr;
   if (hash_ == 0) {
-    hash_ = ComputeHash(value_, length_);
+    hash_ = ComputeHash(value_, length_, Heap::Current()->hash_seed());
     *hash_addr = hash_;
   }
 }
@@ -325,36 +502,50 @@ char* HString::New(Heap* heap,
 }
 
 
+char* HString::NewSymbol(Heap* heap, const char* value, uint32_t length) {
+  return heap->string_table()->Intern(value, length, true);
+}
+
+
 HObject::HObject(char* addr) : HValue(addr) {
   map_slot_ = reinterpret_cast<char**>(addr + 16);
 }
 
 
 char* HObject::NewEmpty(Heap* heap, char* stack_top) {
-  uint32_t size = 16;
+  uint32_t size = 16 + (kInlineProperties << 4);
 
-  char* obj = heap->AllocateTagged(Heap::kTagObject, 16, stack_top);
-  // NOTE: We're not passing stack_top here, because we don't want
-  // GC to run until all object's fields will be filled
-  char* map = heap->AllocateTagged(Heap::kTagMap, (size << 4) + 8, NULL);
+  char* obj = heap->AllocateTagged(Heap::kTagObject, size, stack_top);
 
-  // Set mask
-  *reinterpret_cast<uint64_t*>(obj + 8) = (size - 1) << 3;
-  // Set map
-  *reinterpret_cast<char**>(obj + 16) = map;
+  // Nullify mask, map and all inline entries
+  memset(obj + 8, 0, size);
 
-  // Set map's size
-  *reinterpret_cast<uint64_t*>(map + 8) = size;
+  return obj;
+}
 
-  // Nullify all map's slots (both keys and values)
-  memset(map + 16, 0, size << 4);
 
-  return obj;
+bool HObject::HasMap() {
+  return map() != NULL;
+}
+
+
+bool HObject::IsEmptySlot(uint32_t index) {
+  return *GetSlotAddress(index) == NULL;
+}
+
+
+HValue* HObject::GetSlot(uint32_t index) {
+  return HValue::New(*GetSlotAddress(index));
+}
+
+
+char** HObject::GetSlotAddress(uint32_t index) {
+  return reinterpret_cast<char**>(addr() + 24 + index * 8);
 }
 
 
 HMap::HMap(char* addr) : HValue(addr) {
-  size_ = *reinterpret_cast<uint64_t*>(addr + 8);
+  size_ = *reinterpret_cast<uint32_t*>(addr + 8);
   space_ = addr + 16;
 }
 
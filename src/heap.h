@@ -12,6 +12,7 @@
 
 #include "zone.h" // ZoneObject
 #include "gc.h" // GC
+#include "feedback.h" // FeedbackList
 #include "utils.h"
 
 #include <stdint.h> // uint32_t
@@ -72,6 +73,45 @@ class Space {
   uint32_t page_size_;
 };
 
+// Canonical storage for property names and string literals.
+// Every string is stored only once, so two interned strings are equal if
+// (and only if) their addresses are equal. Symbols referenced by compiled
+// code live in old space, strings interned at runtime live in new space
+// and are dropped from the table when GC finds them unreachable.
+class StringTable {
+ public:
+  StringTable(Heap* heap);
+  ~StringTable();
+
+  // Returns interned string with given contents (creates it if needed)
+  char* Intern(const char* value, uint32_t length, bool immortal);
+
+  // Same as above, but takes heap string and never creates immortal one
+  char* Intern(char* str);
+
+  // Returns NULL if there's no interned string with such contents
+  char* Lookup(const char* value, uint32_t length, uint32_t hash);
+
+  // Called by GC after copying live objects: removes strings that weren't
+  // copied and updates addresses of ones that were
+  void Sweep();
+
+  inline Heap* heap() { return heap_; }
+  inline uint32_t size() { return size_; }
+  inline uint32_t count() { return count_; }
+
+ protected:
+  // Returns address of matching entry or address of empty one
+  char** Find(const char* value, uint32_t length, uint32_t hash);
+  void Grow();
+  void Rehash(uint32_t size);
+
+  Heap* heap_;
+  char** entries_;
+  uint32_t size_;
+  uint32_t count_;
+};
+
 class Heap {
  public:
   enum HeapTag {
@@ -94,12 +134,28 @@ class Heap {
     kErrorCallWithoutVariable
   };
 
+  // Objects with this bit set in the tag word are allocated in old space
+  // and should never be moved or collected by GC
+  static const uint64_t kImmortalBit = 0x40000000;
+
   Heap(uint32_t page_size) : new_space_(this, page_size),
                              old_space_(this, page_size),
+                             string_table_(this),
                              root_stack_(NULL),
                              pending_exception_(NULL),
+                             nil_slot_(NULL),
+                             hash_seed_(GetRandomSeed()),
                              gc_(this) {
     current_ = this;
+    feedback_.allocated = true;
+    memset(number_string_cache_, 0, sizeof(number_string_cache_));
+
+    true_value_ = AllocateBoolean(true);
+    false_value_ = AllocateBoolean(false);
+
+    for (uint32_t i = 0; i < kDoubleBoxCount; i++) {
+      double_boxes_[i] = AllocateImmortal(kTagNumber, 8);
+    }
   }
 
   // TODO: Use thread id
@@ -107,22 +163,87 @@ class Heap {
 
   char* AllocateTagged(HeapTag tag, uint32_t bytes, char* stack_top);
 
+  // Allocate object in old space and mark it as immortal
+  char* AllocateImmortal(HeapTag tag, uint32_t bytes);
+
   inline Space* new_space() { return &new_space_; }
   inline Space* old_space() { return &old_space_; }
+  inline StringTable* string_table() { return &string_table_; }
   inline char** root_stack() { return &root_stack_; }
   inline char** pending_exception() { return &pending_exception_; }
 
+  // Immortal boolean singletons (there're no other boolean values)
+  inline char* true_value() { return true_value_; }
+  inline char* false_value() { return false_value_; }
+
+  // Immortal heap numbers holding intermediate results of arithmetic
+  // expressions (see Fullgen::VisitBinOp), each nesting level of expression
+  // tree uses it's own box and values are never stored anywhere
+  static const uint32_t kDoubleBoxCount = 16;
+  inline char* double_box(uint32_t index) { return double_boxes_[index]; }
+
+  // Always contains nil, returned by property lookups that can't succeed
+  inline char** nil_slot() { return &nil_slot_; }
+
+  // Random seed for string hashes
+  inline uint64_t hash_seed() { return hash_seed_; }
+
+  // Direct-mapped cache of interned string representations of
+  // unboxed numbers (used for numeric property keys). Cached strings are
+  // collectable, GC updates or evicts them (see SweepNumberStrings)
+  static const uint32_t kNumberStringCacheSize = 256;
+
+  inline char* GetNumberString(char* number) {
+    uint32_t index = NumberStringIndex(number);
+    if (number_string_cache_[index] != number) return NULL;
+    return number_string_cache_[index + 1];
+  }
+
+  inline void SetNumberString(char* number, char* str) {
+    uint32_t index = NumberStringIndex(number);
+    number_string_cache_[index] = number;
+    number_string_cache_[index + 1] = str;
+  }
+
+  // Called by GC after copying live objects
+  void SweepNumberStrings();
+
+  // Type feedback of every compiled function (see Fullgen)
+  inline FeedbackList* feedback() { return &feedback_; }
+
   inline GC* gc() { return &gc_; }
 
  private:
   Space new_space_;
   Space old_space_;
 
+  StringTable string_table_;
+
   // Runtime exception support
   // root stack address is needed to unwind stack up to root function's entry
   char* root_stack_;
   char* pending_exception_;
 
+  char* AllocateBoolean(bool value);
+
+  char* true_value_;
+  char* false_value_;
+  char* double_boxes_[kDoubleBoxCount];
+
+  char* nil_slot_;
+  uint64_t hash_seed_;
+
+  inline uint32_t NumberStringIndex(char* number) {
+    uint64_t value = reinterpret_cast<uint64_t>(number) >> 1;
+    return (value & (kNumberStringCacheSize - 1)) << 1;
+  }
+
+  // Pairs of (number, interned string), cache is keyed by tagged numbers
+  // so zero (nil) can't be a valid key
+  char* number_string_cache_[kNumberStringCacheSize * 2];
+
+  FeedbackList feedback_;
+
   GC gc_;
 
   static Heap* current_;
@@ -158,11 +279,14 @@ class HValue : public ZoneObject {
   bool IsGCMarked();
   char* GetGCMark();
 
+  bool IsImmortal();
+
   void SetGCMark(char* new_addr);
   void ResetGCMark();
 
   static Heap::HeapTag GetTag(char* addr);
   static bool IsUnboxed(char* addr);
+  static bool IsImmortal(char* addr);
 
   inline Heap::HeapTag tag() { return tag_; }
   inline void tag(Heap::HeapTag tag) { tag_ = tag; }
@@ -209,7 +333,7 @@ class HNumber : public HValue {
   static char* New(Heap* heap, char* stack_top, uint64_t value);
   static char* New(Heap* heap, char* stack_top, double value);
 
-  static uint64_t Untag(uint64_t value);
+  static int64_t Untag(int64_t value);
   static uint64_t Tag(uint64_t value);
 
   inline double value() { return value_; }
@@ -246,6 +370,9 @@ class HString : public HValue {
                    const char* value,
                    uint32_t length);
 
+  // Returns canonical (interned) string with the same contents
+  static char* NewSymbol(Heap* heap, const char* value, uint32_t length);
+
   inline char* value() { return value_; }
   inline uint32_t length() { return length_; }
   inline uint32_t hash() { return hash_; }
@@ -259,15 +386,24 @@ class HString : public HValue {
 };
 
 
+// Objects with a few properties have no map, but keep up to
+// kInlineProperties entries (key followed by value) right after map slot
 class HObject : public HValue {
  public:
   HObject(char* addr);
 
   static char* NewEmpty(Heap* heap, char* stack_top);
 
+  bool HasMap();
+  bool IsEmptySlot(uint32_t index);
+  HValue* GetSlot(uint32_t index);
+  char** GetSlotAddress(uint32_t index);
+
   inline char* map() { return *map_slot_; }
   inline char** map_slot() { return map_slot_; }
 
+  static const uint32_t kInlineProperties = 4;
+
   static const Heap::HeapTag class_tag = Heap::kTagObject;
 
  protected:
@@ -275,6 +411,8 @@ class HObject : public HValue {
 };
 
 
+// Map's space consists of `size` entries, key is followed by its value
+// (empty entries have NULL key). Count of keys is stored after the size.
 class HMap : public HValue {
  public:
   HMap(char* addr);
@@ -0,0 +1,1652 @@
+#include "hir.h"
+#include "heap.h" // Heap, HNumber
+#include "feedback.h" // FeedbackSite, FeedbackVector
+#include "ast.h" // AstNode, AstValue, BinOp, UnOp
+#include "scope.h" // ScopeSlot
+#include "zone.h" // Zone
+#include "utils.h" // List, PrintBuffer, StringToInt
+
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL
+#include <string.h> // strncmp
+#include <assert.h> // assert
+
+namespace candor {
+
+HIRInstruction::HIRInstruction(Type type) : type_(type),
+                                            id_(-1),
+                                            block_(NULL),
+                                            subtype_(BinOp::kNone),
+                                            feedback_(NULL),
+                                            value_(NULL),
+                                            ast_(NULL),
+                                            index_(-1),
+                                            depth_(0),
+                                            types_(kAnyType),
+                                            interval_(NULL),
+                                            pos_(-1) {
+}
+
+
+// Removes one entry of `value` from list
+static void RemoveOne(HIRInstructionList* list, HIRInstruction* value) {
+  HIRInstructionList::Item* item = list->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() != value) continue;
+    list->Remove(item);
+    return;
+  }
+}
+
+
+void HIRInstruction::AddInput(HIRInstruction* input) {
+  inputs_.Push(input);
+  input->uses_.Push(this);
+}
+
+
+void HIRInstruction::ReplaceInput(HIRInstruction* from, HIRInstruction* to) {
+  HIRInstructionList::Item* item = inputs_.head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() != from) continue;
+
+    item->value(to);
+    RemoveOne(&from->uses_, this);
+    to->uses_.Push(this);
+  }
+}
+
+
+void HIRInstruction::ReplaceWith(HIRInstruction* other) {
+  while (uses_.length() > 0) {
+    uses_.head()->value()->ReplaceInput(this, other);
+  }
+}
+
+
+void HIRInstruction::Remove() {
+  HIRInstruction* input;
+  while ((input = inputs_.Shift()) != NULL) RemoveOne(&input->uses_, this);
+
+  if (block_ == NULL) return;
+  RemoveOne(is(kPhi) ? block_->phis() : block_->instructions(), this);
+  block_ = NULL;
+}
+
+
+uint32_t HIRInstruction::Hash() {
+  uint32_t hash = type_ * 31 + subtype_;
+
+  hash = hash * 31 + static_cast<uint32_t>(reinterpret_cast<uint64_t>(value_));
+  hash = (hash * 31 + index_) * 31 + depth_;
+  HIRInstructionList::Item* item = inputs_.head();
+  for (; item != NULL; item = item->next()) {
+    hash = hash * 31 + item->value()->id();
+  }
+
+  return hash;
+}
+
+
+bool HIRInstruction::Equals(HIRInstruction* other) {
+  if (!is_pure() ||
+      type_ != other->type_ ||
+      subtype_ != other->subtype_ ||
+      value_ != other->value_ ||
+      index_ != other->index_ ||
+      depth_ != other->depth_ ||
+      inputs_.length() != other->inputs_.length()) {
+    return false;
+  }
+
+  HIRInstructionList::Item* a = inputs_.head();
+  HIRInstructionList::Item* b = other->inputs_.head();
+  for (; a != NULL; a = a->next(), b = b->next()) {
+    if (a->value() != b->value()) return false;
+  }
+
+  return true;
+}
+
+
+static const char* BinOpName(BinOp::BinOpType type) {
+  switch (type) {
+   case BinOp::kAdd: return "Add";
+   case BinOp::kSub: return "Sub";
+   case BinOp::kDiv: return "Div";
+   case BinOp::kMul: return "Mul";
+   case BinOp::kMod: return "Mod";
+   case BinOp::kBAnd: return "BAnd";
+   case BinOp::kBOr: return "BOr";
+   case BinOp::kBXor: return "BXor";
+   case BinOp::kShl: return "Shl";
+   case BinOp::kShr: return "Shr";
+   case BinOp::kUShr: return "UShr";
+   case BinOp::kEq: return "Eq";
+   case BinOp::kStrictEq: return "StrictEq";
+   case BinOp::kNe: return "Ne";
+   case BinOp::kStrictNe: return "StrictNe";
+   case BinOp::kLt: return "Lt";
+   case BinOp::kGt: return "Gt";
+   case BinOp::kLe: return "Le";
+   case BinOp::kGe: return "Ge";
+   default: return "?";
+  }
+}
+
+
+bool HIRInstruction::Print(PrintBuffer* p) {
+  switch (type_) {
+   case kGoto:
+    return p->Print("Goto(B%d)", block_->successor(0)->id());
+   case kBranch:
+    return p->Print("Branch(i%d,B%d,B%d)",
+                    lhs()->id(),
+                    block_->successor(0)->id(),
+                    block_->successor(1)->id());
+   case kReturn:
+    return p->Print("Return(i%d)", lhs()->id());
+   default:
+    break;
+  }
+
+  if (!p->Print("i%d=", id_)) return false;
+
+  switch (type_) {
+   case kParameter:
+    return p->Print("Param(%d)", index_);
+   case kOsrValue:
+    return p->Print("OsrValue(%d)", index_);
+   case kConstant:
+    if (value_ == NULL) return p->Print("nil");
+    if (HValue::IsUnboxed(value_)) {
+      return p->Print("%lld", static_cast<long long>(
+          HNumber::Untag(reinterpret_cast<int64_t>(value_))));
+    }
+    if (HValue::GetTag(value_) == Heap::kTagBoolean) {
+      return p->Print(HValue::As<HBoolean>(value_)->is_true() ?
+          "true" : "false");
+    }
+    return p->Print("%g", HValue::As<HNumber>(value_)->value());
+   case kNot:
+    return p->Print("Not(i%d)", lhs()->id());
+   case kLoadContext:
+    return p->Print("LoadContext(%d,%d)", depth_, index_);
+   default:
+    break;
+  }
+
+  const char* name = "%s(";
+  if (is(kPhi)) name = "Phi(";
+  if (is(kSnapshot)) name = "Snapshot(";
+  if (is(kCheckTarget)) name = "CheckTarget(";
+  if (is(kAllocateObject)) name = "Object(";
+  if (is(kLoadProperty)) name = "LoadProperty(";
+  if (!p->Print(name, BinOpName(subtype_))) return false;
+
+  HIRInstructionList::Item* item = inputs_.head();
+  for (; item != NULL; item = item->next()) {
+    if (!p->Print(item == inputs_.head() ? "i%d" : ",i%d",
+                  item->value()->id())) {
+      return false;
+    }
+  }
+
+  return p->Print(")");
+}
+
+
+HIRBlock::HIRBlock(int32_t id, int32_t slots) : id_(id),
+                                                successor_count_(0),
+                                                slots_(slots),
+                                                loop_header_(false),
+                                                sealed_(false),
+                                                dominator_(NULL),
+                                                rpo_(-1),
+                                                loop_depth_(0),
+                                                loop_(NULL),
+                                                restart_(NULL),
+                                                outer_restart_(NULL),
+                                                snapshot_(NULL),
+                                                start_(-1),
+                                                end_(-1),
+                                                live_in_(NULL) {
+  successors_[0] = NULL;
+  successors_[1] = NULL;
+  env_ = Zone::NewArray<HIRInstruction*>(slots);
+}
+
+
+void HIRBlock::Append(HIRInstruction* instr) {
+  instr->block(this);
+  if (instr->is(HIRInstruction::kPhi)) {
+    phis_.Push(instr);
+  } else {
+    instructions_.Push(instr);
+  }
+}
+
+
+void HIRBlock::InsertBeforeEnd(HIRInstruction* instr) {
+  instr->block(this);
+  instructions_.InsertBefore(is_terminated() ? instructions_.tail() : NULL,
+                             instr);
+}
+
+
+void HIRBlock::AddPredecessor(HIRBlock* pred) {
+  predecessors_.Push(pred);
+  assert(pred->successor_count_ < 2);
+  pred->successors_[pred->successor_count_++] = this;
+
+  // Back edge of loop
+  if (!sealed_ || !loop_header_) return;
+
+  HIRInstructionList::Item* item = phis_.head();
+  for (; item != NULL; item = item->next()) {
+    HIRInstruction* phi = item->value();
+    phi->AddInput(pred->env_[phi->index()]);
+  }
+}
+
+
+void HIRBlock::ReplacePredecessor(HIRBlock* from, HIRBlock* to) {
+  HIRBlockList::Item* item = predecessors_.head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() == from) item->value(to);
+  }
+}
+
+
+void HIRBlock::ReplaceSuccessor(HIRBlock* from, HIRBlock* to) {
+  for (int32_t i = 0; i < successor_count_; i++) {
+    if (successors_[i] == from) successors_[i] = to;
+  }
+}
+
+
+int32_t HIRBlock::PredecessorIndex(HIRBlock* pred) {
+  int32_t index = 0;
+  HIRBlockList::Item* item = predecessors_.head();
+  for (; item != NULL; item = item->next(), index++) {
+    if (item->value() == pred) return index;
+  }
+
+  return -1;
+}
+
+
+bool HIRBlock::Dominates(HIRBlock* other) {
+  for (; other != NULL; other = other->dominator()) {
+    if (other == this) return true;
+  }
+  return false;
+}
+
+
+HIRGen::HIRGen(Heap* heap, AstNode* fn, AstNode* osr)
+    : Visitor(kPreorder),
+      heap_(heap),
+      fn_(FunctionLiteral::Cast(fn)),
+      osr_(osr),
+      bailout_(false),
+      entry_(NULL),
+      current_(NULL),
+      value_(NULL),
+      nil_(NULL),
+      slots_(fn->stack_slots()),
+      restart_(NULL),
+      inlined_(NULL),
+      inlined_base_(fn->stack_slots()),
+      inlined_exit_(NULL),
+      block_id_(0),
+      instruction_id_(0),
+      order_(NULL),
+      order_count_(0) {
+}
+
+
+bool HIRGen::Build() {
+  // Context variables may be captured by nested functions
+  if (fn()->context_slots() != 0) return false;
+
+  // Inlined functions' variables live in slots after function's own ones
+  slots_ += InlinedSlots(fn());
+
+  entry_ = CreateBlock();
+  SetCurrent(entry_);
+
+  // Arguments are still on stack, so function may be restarted from entry
+  // (code replaced on stack can be restarted only from it's loop)
+  if (osr_ == NULL) {
+    entry_->restart(fn());
+    restart_ = entry_;
+  }
+
+  // Arguments are loaded into stack slots
+  AstList::Item* item = fn()->args()->head();
+  for (int32_t i = 0; item != NULL; item = item->next(), i++) {
+    AstValue* arg = AstValue::Cast(item->value());
+    if (!arg->is_slot() || !arg->slot()->is_stack()) return false;
+
+    HIRInstruction* param = new HIRInstruction(HIRInstruction::kParameter);
+    param->index(i);
+    current_->env()[arg->slot()->index()] = Add(param);
+  }
+
+  if (osr_ != NULL) {
+    // Arguments are already in their slots
+    for (int32_t i = 0; i < inlined_base_; i++) {
+      HIRInstruction* value = new HIRInstruction(HIRInstruction::kOsrValue);
+      value->index(i);
+      current_->env()[i] = Add(value);
+    }
+
+    // Entry will jump to the loop (see VisitWhile)
+    SetCurrent(CreateBlock());
+  }
+
+  VisitStatements(fn());
+
+  // Function without `return` returns nil
+  if (!current_->is_terminated()) Return(nil_);
+
+  // Loop may be inside of unsupported code
+  if (osr_ != NULL && !entry_->is_terminated()) return false;
+
+  return !bailout_;
+}
+
+
+HIRInstruction* HIRGen::VisitForValue(AstNode* node) {
+  if (bailout_) return nil_;
+
+  switch (node->type()) {
+   case AstNode::kBreak:
+   case AstNode::kBlockExpr:
+   case AstNode::kMValue:
+    return Bailout();
+   default:
+    break;
+  }
+
+  value_ = NULL;
+  Visit(node);
+  HIRInstruction* result = value_ == NULL ? nil_ : value_;
+  value_ = NULL;
+
+  return result;
+}
+
+
+void HIRGen::VisitStatements(AstNode* node) {
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL && !bailout_; item = item->next()) {
+    VisitForValue(item->value());
+  }
+}
+
+
+void HIRGen::VisitForControl(AstNode* node,
+                             HIRBlock* is_true,
+                             HIRBlock* is_false) {
+  // !expr - just swap targets
+  if (node->is(AstNode::kUnOp) && UnOp::Cast(node)->subtype() == UnOp::kNot) {
+    VisitForControl(node->lhs(), is_false, is_true);
+    return;
+  }
+
+  if (node->is(AstNode::kBinOp) && BinOp::Cast(node)->is_logic()) {
+    HIRBlock* rhs = CreateBlock();
+
+    if (BinOp::Cast(node)->subtype() == BinOp::kLAnd) {
+      VisitForControl(node->lhs(), rhs, is_false);
+    } else {
+      VisitForControl(node->lhs(), is_true, rhs);
+    }
+
+    SetCurrent(rhs);
+    VisitForControl(node->rhs(), is_true, is_false);
+    return;
+  }
+
+  Branch(VisitForValue(node), is_true, is_false);
+}
+
+
+HIRInstruction* HIRGen::Bailout() {
+  bailout_ = true;
+  return nil_;
+}
+
+
+HIRBlock* HIRGen::CreateBlock() {
+  HIRBlock* block = new HIRBlock(block_id_++, slots_);
+  blocks_.Push(block);
+
+  return block;
+}
+
+
+HIRInstruction* HIRGen::Add(HIRInstruction* instr) {
+  instr->id(instruction_id_++);
+  current_->Append(instr);
+
+  return instr;
+}
+
+
+HIRInstruction* HIRGen::AddConstant(char* value) {
+  HIRInstruction* instr = new HIRInstruction(HIRInstruction::kConstant);
+  instr->value(value);
+
+  return Add(instr);
+}
+
+
+HIRInstruction* HIRGen::AddBinOp(BinOp::BinOpType type,
+                                 HIRInstruction* lhs,
+                                 HIRInstruction* rhs,
+                                 FeedbackSite* feedback) {
+  HIRInstruction* instr = new HIRInstruction(HIRInstruction::kBinOp);
+  instr->subtype(type);
+  instr->feedback(feedback);
+  instr->AddInput(lhs);
+  instr->AddInput(rhs);
+
+  // Speculate on unboxed numbers if nothing else was seen
+  if (feedback != NULL &&
+      feedback->types() == FeedbackSite::kSmi &&
+      restart_ != NULL) {
+    instr->AddInput(Snapshot(restart_));
+  }
+
+  return Add(instr);
+}
+
+
+HIRInstruction* HIRGen::AddPhi(HIRBlock* block, int32_t slot) {
+  HIRInstruction* phi = new HIRInstruction(HIRInstruction::kPhi);
+  phi->id(instruction_id_++);
+  phi->index(slot);
+  block->Append(phi);
+
+  return phi;
+}
+
+
+HIRInstruction* HIRGen::Snapshot(HIRBlock* restart) {
+  if (restart->snapshot_ != NULL) return restart->snapshot_;
+
+  // Loop invariant code may be hoisted to outer restart point later,
+  // when phis of it's header are already replaced
+  if (restart->outer_restart() != NULL) Snapshot(restart->outer_restart());
+
+  HIRInstruction* snapshot = new HIRInstruction(HIRInstruction::kSnapshot);
+  snapshot->id(instruction_id_++);
+  snapshot->ast(restart->restart());
+
+  // Loop's header has a phi for every stack slot (in order of slots),
+  // function's entry needs only arguments that are still on stack
+  if (restart != entry_) {
+    HIRInstructionList::Item* item = restart->phis()->head();
+    for (; item != NULL; item = item->next()) {
+      if (item->value()->index() >= inlined_base_) break;
+      snapshot->AddInput(item->value());
+    }
+  }
+  restart->InsertBeforeEnd(snapshot);
+  restart->snapshot_ = snapshot;
+
+  return snapshot;
+}
+
+
+// Block is reachable if it's an entry or something jumps into it
+static inline bool IsReachable(HIRBlock* block, HIRBlock* entry) {
+  return block == entry || block->predecessors()->length() > 0;
+}
+
+
+void HIRGen::Goto(HIRBlock* target) {
+  HIRBlock* block = current_;
+  Add(new HIRInstruction(HIRInstruction::kGoto));
+
+  if (IsReachable(block, entry_)) target->AddPredecessor(block);
+}
+
+
+void HIRGen::Branch(HIRInstruction* value,
+                    HIRBlock* is_true,
+                    HIRBlock* is_false) {
+  HIRBlock* block = current_;
+  HIRInstruction* branch = new HIRInstruction(HIRInstruction::kBranch);
+  branch->AddInput(value);
+  Add(branch);
+
+  if (IsReachable(block, entry_)) {
+    is_true->AddPredecessor(block);
+    is_false->AddPredecessor(block);
+  }
+}
+
+
+void HIRGen::Return(HIRInstruction* value) {
+  HIRInstruction* ret = new HIRInstruction(HIRInstruction::kReturn);
+  ret->AddInput(value);
+  Add(ret);
+
+  // Code after `return` is unreachable
+  SetCurrent(CreateBlock());
+}
+
+
+void HIRGen::SetCurrent(HIRBlock* block) {
+  current_ = block;
+  if (block->is_sealed()) return;
+  block->sealed(true);
+
+  HIRInstruction** env = block->env();
+  HIRBlockList* preds = block->predecessors();
+
+  if (block == entry_) {
+    nil_ = AddConstant(NULL);
+    for (int32_t i = 0; i < slots_; i++) env[i] = nil_;
+    return;
+  }
+
+  if (preds->length() == 0) {
+    // Unreachable block
+    for (int32_t i = 0; i < slots_; i++) env[i] = nil_;
+    return;
+  }
+
+  HIRInstruction** first = preds->head()->value()->env();
+  for (int32_t i = 0; i < slots_; i++) {
+    env[i] = first[i];
+
+    // Loop header will get values from back edges later
+    bool need_phi = block->is_loop_header();
+
+    HIRBlockList::Item* item = preds->head()->next();
+    for (; !need_phi && item != NULL; item = item->next()) {
+      need_phi = item->value()->env()[i] != first[i];
+    }
+    if (!need_phi) continue;
+
+    HIRInstruction* phi = AddPhi(block, i);
+    for (item = preds->head(); item != NULL; item = item->next()) {
+      phi->AddInput(item->value()->env()[i]);
+    }
+    env[i] = phi;
+  }
+}
+
+
+AstNode* HIRGen::VisitFunction(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitCall(AstNode* node) {
+  FunctionLiteral* call = FunctionLiteral::Cast(node);
+
+  // Deoptimization restarts caller, callee can't be restarted by itself
+  FunctionLiteral* callee = NULL;
+  if (inlined_ == NULL && restart_ != NULL) callee = InlineTarget(node);
+  if (callee == NULL) {
+    Bailout();
+    return node;
+  }
+
+  // Variable should still hold the function that call site has seen
+  HIRInstruction* check = new HIRInstruction(HIRInstruction::kCheckTarget);
+  check->value(reinterpret_cast<char*>(call->feedback()->target()));
+  check->AddInput(VisitForValue(call->variable()));
+  check->AddInput(Snapshot(restart_));
+  Add(check);
+
+  int32_t argc = call->args()->length();
+  HIRInstruction** args = Zone::NewArray<HIRInstruction*>(argc);
+  AstList::Item* item = call->args()->head();
+  for (int32_t i = 0; item != NULL; item = item->next(), i++) {
+    args[i] = VisitForValue(item->value());
+  }
+
+  value_ = Inline(callee, args, argc);
+
+  return node;
+}
+
+
+// Callee may be inlined if it's small, doesn't call anything and
+// uses only it's own stack variables
+static bool IsInlineable(AstNode* node, int32_t* size) {
+  if (++*size > HIRGen::kMaxInlineSize) return false;
+
+  switch (node->type()) {
+   case AstNode::kFunction:
+   case AstNode::kCall:
+    return false;
+   case AstNode::kValue:
+    return AstValue::Cast(node)->is_slot() &&
+           AstValue::Cast(node)->slot()->is_stack();
+   default:
+    break;
+  }
+
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!IsInlineable(item->value(), size)) return false;
+  }
+
+  return true;
+}
+
+
+FunctionLiteral* HIRGen::InlineTarget(AstNode* node) {
+  FunctionLiteral* call = FunctionLiteral::Cast(node);
+  FeedbackSite* site = call->feedback();
+
+  if (site == NULL ||
+      !site->is_monomorphic() ||
+      call->variable() == NULL ||
+      !call->variable()->is(AstNode::kValue)) {
+    return NULL;
+  }
+
+  // Function objects reference fullgen's code of function's entry
+  char* target = reinterpret_cast<char*>(site->target());
+  FeedbackList::Item* item = heap()->feedback()->head();
+  for (; item != NULL; item = item->next()) {
+    FeedbackVector* vector = item->value();
+    if (vector->ResumePoint(vector->fn()) == target) break;
+  }
+  if (item == NULL) return NULL;
+
+  FunctionLiteral* callee = FunctionLiteral::Cast(item->value()->fn());
+  if (callee->is_root() || callee->context_slots() != 0) return NULL;
+
+  AstList::Item* arg = callee->args()->head();
+  for (; arg != NULL; arg = arg->next()) {
+    if (!arg->value()->is(AstNode::kValue)) return NULL;
+
+    AstValue* value = AstValue::Cast(arg->value());
+    if (!value->is_slot() || !value->slot()->is_stack()) return NULL;
+  }
+
+  int32_t size = 0;
+  AstList::Item* child = callee->children()->head();
+  for (; child != NULL; child = child->next()) {
+    if (!IsInlineable(child->value(), &size)) return NULL;
+  }
+
+  return callee;
+}
+
+
+int32_t HIRGen::InlinedSlots(AstNode* node) {
+  // Calls are inlined one at a time, so they may share slots
+  int32_t slots = 0;
+  if (node->is(AstNode::kCall)) {
+    FunctionLiteral* callee = InlineTarget(node);
+    if (callee != NULL) slots = callee->stack_slots();
+
+    AstList::Item* item = FunctionLiteral::Cast(node)->args()->head();
+    for (; item != NULL; item = item->next()) {
+      int32_t arg = InlinedSlots(item->value());
+      if (arg > slots) slots = arg;
+    }
+  }
+
+  // Nested functions aren't optimized with their parent
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value()->is(AstNode::kFunction)) continue;
+
+    int32_t child = InlinedSlots(item->value());
+    if (child > slots) slots = child;
+  }
+
+  return slots;
+}
+
+
+HIRInstruction* HIRGen::Inline(FunctionLiteral* callee,
+                               HIRInstruction** args,
+                               int32_t argc) {
+  inlined_ = callee;
+  inlined_exit_ = CreateBlock();
+  while (inlined_values_.length() > 0) inlined_values_.Shift();
+
+  HIRInstruction** env = current_->env();
+  for (int32_t i = 0; i < callee->stack_slots(); i++) {
+    env[inlined_base_ + i] = nil_;
+  }
+
+  // Arguments are pushed in order, so the first parameter gets the last one
+  AstList::Item* item = callee->args()->head();
+  for (int32_t i = 0; item != NULL && i < argc; item = item->next(), i++) {
+    env[StackIndex(item->value())] = args[argc - i - 1];
+  }
+
+  VisitStatements(callee);
+
+  // Function without `return` returns nil
+  if (IsReachable(current_, entry_)) inlined_values_.Push(nil_);
+  Goto(inlined_exit_);
+
+  inlined_ = NULL;
+  SetCurrent(inlined_exit_);
+
+  HIRBlockList* preds = inlined_exit_->predecessors();
+  if (preds->length() == 0) return nil_;
+  if (preds->length() == 1) return inlined_values_.head()->value();
+
+  HIRInstruction* phi = AddPhi(inlined_exit_, -1);
+  HIRInstructionList::Item* value = inlined_values_.head();
+  for (; value != NULL; value = value->next()) phi->AddInput(value->value());
+
+  return phi;
+}
+
+
+AstNode* HIRGen::VisitBlock(AstNode* node) {
+  VisitStatements(node);
+  return node;
+}
+
+
+AstNode* HIRGen::VisitScopeDecl(AstNode* node) {
+  return node;
+}
+
+
+AstNode* HIRGen::VisitIf(AstNode* node) {
+  HIRBlock* restart = restart_;
+  AstList::Item* fail_item = node->children()->head()->next()->next();
+  AstNode* fail = fail_item == NULL ? NULL : fail_item->value();
+
+  HIRBlock* success_block = CreateBlock();
+  HIRBlock* fail_block = CreateBlock();
+  HIRBlock* join = fail == NULL ? fail_block : CreateBlock();
+
+  VisitForControl(node->lhs(), success_block, fail_block);
+
+  SetCurrent(success_block);
+  VisitForValue(node->rhs());
+  Goto(join);
+
+  if (fail != NULL) {
+    SetCurrent(fail_block);
+    VisitForValue(fail);
+    Goto(join);
+  }
+
+  // Loops in branches don't dominate the join
+  SetCurrent(join);
+  restart_ = restart;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitWhile(AstNode* node) {
+  HIRBlock* header = CreateBlock();
+  HIRBlock* body = CreateBlock();
+  HIRBlock* exit = CreateBlock();
+
+  header->loop_header(true);
+
+  // Fullgen has resume points only in loops of optimized function itself
+  if (inlined_ == NULL) {
+    header->restart(node);
+    header->outer_restart(node == osr_ ? NULL : restart_);
+  }
+
+  Goto(header);
+
+  // On-stack replacement enters loop from fullgen code
+  if (node == osr_) {
+    HIRBlock* block = current_;
+    current_ = entry_;
+    Goto(header);
+    current_ = block;
+  }
+
+  SetCurrent(header);
+  if (inlined_ == NULL) restart_ = header;
+  VisitForControl(node->lhs(), body, exit);
+
+  SetCurrent(body);
+  VisitForValue(node->rhs());
+  Goto(header);
+
+  // Header dominates loop's exit
+  SetCurrent(exit);
+  if (inlined_ == NULL) restart_ = header;
+
+  return node;
+}
+
+
+int32_t HIRGen::StackIndex(AstNode* node) {
+  if (!node->is(AstNode::kValue)) return -1;
+
+  AstValue* value = AstValue::Cast(node);
+  if (!value->is_slot() || !value->slot()->is_stack()) return -1;
+
+  if (inlined_ != NULL) return inlined_base_ + value->slot()->index();
+  return value->slot()->index();
+}
+
+
+AstNode* HIRGen::VisitAssign(AstNode* node) {
+  int32_t index = StackIndex(node->lhs());
+  if (index == -1) {
+    Bailout();
+    return node;
+  }
+
+  HIRInstruction* value = VisitForValue(node->rhs());
+  current_->env()[index] = value;
+  value_ = value;
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitMember(AstNode* node) {
+  // Only properties with constant names may be replaced by values
+  AstNode* key = node->rhs();
+  if (!key->is(AstNode::kProperty) && !key->is(AstNode::kString)) {
+    Bailout();
+    return node;
+  }
+
+  HIRInstruction* load = new HIRInstruction(HIRInstruction::kLoadProperty);
+  load->ast(key);
+  load->AddInput(VisitForValue(node->lhs()));
+  value_ = Add(load);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitValue(AstNode* node) {
+  int32_t index = StackIndex(node);
+  if (index != -1) {
+    value_ = current_->env()[index];
+    return node;
+  }
+
+  // Variables of outer functions and globals may be read (optimized code
+  // doesn't call anything that could change them). Function doesn't have
+  // context of it's own, so variables at depth 0 are in parent's one
+  AstValue* value = AstValue::Cast(node);
+  if (inlined_ != NULL ||
+      !value->is_slot() ||
+      !value->slot()->is_context()) {
+    Bailout();
+    return node;
+  }
+
+  HIRInstruction* load = new HIRInstruction(HIRInstruction::kLoadContext);
+  load->depth(value->slot()->depth());
+  load->index(value->slot()->index());
+  value_ = Add(load);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitNumber(AstNode* node) {
+  // Function may be optimized many times, box the literal only once
+  if (node->boxed() != NULL) {
+    value_ = AddConstant(node->boxed());
+    return node;
+  }
+
+  double number;
+
+  if (StringIsDouble(node->value(), node->length())) {
+    number = StringToDouble(node->value(), node->length());
+  } else {
+    uint64_t value = StringToInt(node->value(), node->length());
+
+    if (value < (1ULL << 62)) {
+      value_ = AddConstant(reinterpret_cast<char*>(HNumber::Tag(value)));
+      return node;
+    }
+    number = static_cast<double>(value);
+  }
+
+  // Code references constant directly, so it shouldn't move
+  char* boxed = heap()->AllocateImmortal(Heap::kTagNumber, 8);
+  *reinterpret_cast<double*>(boxed + 8) = number;
+  node->boxed(boxed);
+  value_ = AddConstant(boxed);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitObjectLiteral(AstNode* node) {
+  HIRInstruction* obj = new HIRInstruction(HIRInstruction::kAllocateObject);
+  obj->ast(node);
+
+  AstList::Item* item = ObjectLiteral::Cast(node)->values()->head();
+  for (; item != NULL; item = item->next()) {
+    obj->AddInput(VisitForValue(item->value()));
+  }
+  value_ = Add(obj);
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitArrayLiteral(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitNil(AstNode* node) {
+  value_ = nil_;
+  return node;
+}
+
+
+AstNode* HIRGen::VisitTrue(AstNode* node) {
+  value_ = AddConstant(heap()->true_value());
+  return node;
+}
+
+
+AstNode* HIRGen::VisitFalse(AstNode* node) {
+  value_ = AddConstant(heap()->false_value());
+  return node;
+}
+
+
+AstNode* HIRGen::VisitReturn(AstNode* node) {
+  HIRInstruction* value = nil_;
+  if (node->lhs() != NULL) value = VisitForValue(node->lhs());
+
+  if (inlined_ == NULL) {
+    Return(value);
+    return node;
+  }
+
+  // Inlined function continues after the call
+  if (IsReachable(current_, entry_)) inlined_values_.Push(value);
+  Goto(inlined_exit_);
+  SetCurrent(CreateBlock());
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitProperty(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitString(AstNode* node) {
+  Bailout();
+  return node;
+}
+
+
+AstNode* HIRGen::VisitUnOp(AstNode* node) {
+  UnOp* op = UnOp::Cast(node);
+
+  if (op->subtype() == UnOp::kNot) {
+    HIRInstruction* instr = new HIRInstruction(HIRInstruction::kNot);
+    instr->AddInput(VisitForValue(op->lhs()));
+    value_ = Add(instr);
+    return node;
+  }
+
+  int32_t index = StackIndex(op->lhs());
+  if (!op->is_changing() || index == -1) {
+    Bailout();
+    return node;
+  }
+
+  // ++a is a = a + 1, and a++ is the same but with old value as result
+  bool is_inc = op->subtype() == UnOp::kPreInc ||
+                op->subtype() == UnOp::kPostInc;
+  HIRInstruction* old = current_->env()[index];
+  HIRInstruction* value = AddBinOp(is_inc ? BinOp::kAdd : BinOp::kSub,
+                                   old,
+                                   AddConstant(reinterpret_cast<char*>(
+                                       HNumber::Tag(1))),
+                                   op->feedback());
+  current_->env()[index] = value;
+
+  if (op->subtype() == UnOp::kPreInc || op->subtype() == UnOp::kPreDec) {
+    value_ = value;
+  } else {
+    value_ = old;
+  }
+
+  return node;
+}
+
+
+AstNode* HIRGen::VisitBinOp(AstNode* node) {
+  BinOp* op = BinOp::Cast(node);
+
+  if (!op->is_logic()) {
+    HIRInstruction* lhs = VisitForValue(op->lhs());
+    HIRInstruction* rhs = VisitForValue(op->rhs());
+    value_ = AddBinOp(op->subtype(), lhs, rhs, op->feedback());
+    return node;
+  }
+
+  // `a && b` is `a` if it's falsy and `b` otherwise,
+  // `a || b` is `a` if it's truthy and `b` otherwise
+  HIRInstruction* lhs = VisitForValue(op->lhs());
+  HIRBlock* rhs_block = CreateBlock();
+  HIRBlock* join = CreateBlock();
+
+  if (op->subtype() == BinOp::kLAnd) {
+    Branch(lhs, rhs_block, join);
+  } else {
+    Branch(lhs, join, rhs_block);
+  }
+  HIRBlock* lhs_end = current_;
+
+  SetCurrent(rhs_block);
+  HIRInstruction* rhs = VisitForValue(op->rhs());
+  Goto(join);
+
+  SetCurrent(join);
+
+  HIRBlockList* preds = join->predecessors();
+  if (preds->length() < 2) {
+    value_ = preds->length() == 0 || preds->head()->value() == lhs_end ?
+        lhs : rhs;
+    return node;
+  }
+
+  HIRInstruction* phi = AddPhi(join, -1);
+  HIRBlockList::Item* item = preds->head();
+  for (; item != NULL; item = item->next()) {
+    phi->AddInput(item->value() == lhs_end ? lhs : rhs);
+  }
+  value_ = phi;
+
+  return node;
+}
+
+
+bool HIRGen::Optimize() {
+  RemoveUnreachable();
+  RemoveTrivialPhis();
+  if (!ReplaceObjects()) return false;
+  ComputeOrder();
+  ComputeDominators();
+  FindLoops();
+  NumberValues();
+  HoistLoopInvariants();
+  EliminateDeadCode();
+  InferTypes();
+  SplitCriticalEdges();
+
+  // Split edges have added new blocks
+  ComputeOrder();
+
+  return true;
+}
+
+
+void HIRGen::RemoveUnreachable() {
+  HIRBlockList::Item* item = blocks_.head();
+  for (; item != NULL; item = item->next()) {
+    HIRBlock* block = item->value();
+    if (IsReachable(block, entry_)) continue;
+
+    // Instructions of unreachable blocks may only be used by each other
+    while (block->phis()->length() > 0) block->phis()->head()->value()->Remove();
+    while (block->instructions()->length() > 0) {
+      block->instructions()->head()->value()->Remove();
+    }
+  }
+}
+
+
+void HIRGen::RemoveTrivialPhis() {
+  // Phi is trivial if it merges only one value (and maybe itself)
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    HIRBlockList::Item* bitem = blocks_.head();
+    for (; bitem != NULL; bitem = bitem->next()) {
+      HIRInstructionList::Item* item = bitem->value()->phis()->head();
+      while (item != NULL) {
+        HIRInstruction* phi = item->value();
+        item = item->next();
+
+        HIRInstruction* same = NULL;
+        bool trivial = true;
+        HIRInstructionList::Item* input = phi->inputs()->head();
+        for (; trivial && input != NULL; input = input->next()) {
+          if (input->value() == phi || input->value() == same) continue;
+          trivial = same == NULL;
+          same = input->value();
+        }
+        if (!trivial) continue;
+
+        phi->ReplaceWith(same == NULL ? nil_ : same);
+        phi->Remove();
+        changed = true;
+      }
+    }
+  }
+}
+
+
+// Returns value of object literal's property, or nil instruction if
+// there's no such property
+static HIRInstruction* PropertyValue(HIRInstruction* obj,
+                                     AstNode* key,
+                                     HIRInstruction* nil) {
+  HIRInstruction* result = nil;
+
+  // Last of the same keys wins, like in fullgen
+  AstList::Item* name = ObjectLiteral::Cast(obj->ast())->keys()->head();
+  HIRInstructionList::Item* value = obj->inputs()->head();
+  for (; name != NULL; name = name->next(), value = value->next()) {
+    if (name->value()->length() == key->length() &&
+        strncmp(name->value()->value(), key->value(), key->length()) == 0) {
+      result = value->value();
+    }
+  }
+
+  return result;
+}
+
+
+bool HIRGen::ReplaceObjects() {
+  // Phis used only by snapshots are dead: after restart fullgen assigns
+  // variable before reading it, so it may have any value
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    HIRBlockList::Item* bitem = blocks_.head();
+    for (; bitem != NULL; bitem = bitem->next()) {
+      HIRInstructionList::Item* item = bitem->value()->phis()->head();
+      while (item != NULL) {
+        HIRInstruction* phi = item->value();
+        item = item->next();
+
+        bool dead = true;
+        HIRInstructionList::Item* use = phi->uses()->head();
+        for (; dead && use != NULL; use = use->next()) {
+          dead = use->value() == phi ||
+                 use->value()->is(HIRInstruction::kSnapshot);
+        }
+        if (!dead) continue;
+
+        phi->ReplaceWith(nil_);
+        phi->Remove();
+        changed = true;
+      }
+    }
+  }
+
+  // Object doesn't escape if properties are only loaded from it, loads are
+  // replaced by values and snapshots keep the object for deoptimization
+  HIRBlockList::Item* bitem = blocks_.head();
+  for (; bitem != NULL; bitem = bitem->next()) {
+    HIRInstructionList::Item* item = bitem->value()->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      HIRInstruction* obj = item->value();
+      if (!obj->is(HIRInstruction::kAllocateObject)) continue;
+
+      HIRInstructionList::Item* use = obj->uses()->head();
+      for (; use != NULL; use = use->next()) {
+        HIRInstruction* value = use->value();
+        if (value->is(HIRInstruction::kSnapshot)) continue;
+
+        // Optimized code can't allocate objects
+        if (!value->is(HIRInstruction::kLoadProperty) || value->lhs() != obj) {
+          return false;
+        }
+      }
+
+      use = obj->uses()->head();
+      while (use != NULL) {
+        HIRInstruction* load = use->value();
+        use = use->next();
+        if (!load->is(HIRInstruction::kLoadProperty)) continue;
+
+        load->ReplaceWith(PropertyValue(obj, load->ast(), nil_));
+        load->Remove();
+      }
+    }
+  }
+
+  // Properties of anything else can't be loaded
+  for (bitem = blocks_.head(); bitem != NULL; bitem = bitem->next()) {
+    HIRInstructionList::Item* item = bitem->value()->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      if (item->value()->is(HIRInstruction::kLoadProperty)) return false;
+    }
+  }
+
+  return true;
+}
+
+
+static void VisitPostOrder(HIRBlock* block, HIRBlock** order, int32_t* count) {
+  block->rpo(0);
+
+  // Successors are visited in reverse, so loop's body follows it's header
+  for (int32_t i = block->successor_count() - 1; i >= 0; i--) {
+    HIRBlock* succ = block->successor(i);
+    if (succ->rpo() == -1) VisitPostOrder(succ, order, count);
+  }
+
+  order[(*count)++] = block;
+}
+
+
+void HIRGen::ComputeOrder() {
+  HIRBlockList::Item* item = blocks_.head();
+  for (; item != NULL; item = item->next()) item->value()->rpo(-1);
+
+  HIRBlock** postorder = Zone::NewArray<HIRBlock*>(blocks_.length());
+  order_count_ = 0;
+  VisitPostOrder(entry_, postorder, &order_count_);
+
+  order_ = Zone::NewArray<HIRBlock*>(order_count_);
+  for (int32_t i = 0; i < order_count_; i++) {
+    order_[i] = postorder[order_count_ - i - 1];
+    order_[i]->rpo(i);
+  }
+}
+
+
+static HIRBlock* IntersectDominators(HIRBlock* a, HIRBlock* b) {
+  while (a != b) {
+    while (a->rpo() > b->rpo()) a = a->dominator();
+    while (b->rpo() > a->rpo()) b = b->dominator();
+  }
+  return a;
+}
+
+
+void HIRGen::ComputeDominators() {
+  // "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy
+  for (int32_t i = 0; i < order_count_; i++) order_[i]->dominator(NULL);
+  entry_->dominator(entry_);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int32_t i = 1; i < order_count_; i++) {
+      HIRBlock* block = order_[i];
+      HIRBlock* dominator = NULL;
+
+      HIRBlockList::Item* item = block->predecessors()->head();
+      for (; item != NULL; item = item->next()) {
+        HIRBlock* pred = item->value();
+        if (pred->dominator() == NULL) continue;
+
+        dominator = dominator == NULL ? pred :
+                                        IntersectDominators(pred, dominator);
+      }
+
+      if (block->dominator() != dominator) {
+        block->dominator(dominator);
+        changed = true;
+      }
+    }
+  }
+
+  // Make chains finite
+  entry_->dominator(NULL);
+}
+
+
+// Returns the only predecessor of loop header that is outside of loop
+static HIRBlock* PreHeader(HIRBlock* header) {
+  HIRBlockList::Item* item = header->predecessors()->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value()->rpo() < header->rpo()) return item->value();
+  }
+  return NULL;
+}
+
+
+// Returns true if block is in loop with `header` or in it's nested loops
+static bool InLoop(HIRBlock* block, HIRBlock* header) {
+  for (HIRBlock* loop = block->loop(); loop != NULL;) {
+    if (loop == header) return true;
+    loop = PreHeader(loop)->loop();
+  }
+  return false;
+}
+
+
+void HIRGen::FindLoops() {
+  // Headers are visited in RPO, so inner loops override outer ones
+  for (int32_t i = 0; i < order_count_; i++) {
+    HIRBlock* header = order_[i];
+    if (!header->is_loop_header()) continue;
+
+    HIRBlockList worklist;
+    HIRBlockList::Item* item = header->predecessors()->head();
+    for (; item != NULL; item = item->next()) {
+      if (header->Dominates(item->value())) worklist.Push(item->value());
+    }
+
+    // Loop consists of blocks that reach back edges without passing header
+    header->loop(header);
+    header->loop_depth(header->loop_depth() + 1);
+
+    HIRBlock* block;
+    while ((block = worklist.Shift()) != NULL) {
+      if (block->loop() == header) continue;
+      block->loop(header);
+      block->loop_depth(block->loop_depth() + 1);
+
+      for (item = block->predecessors()->head();
+           item != NULL;
+           item = item->next()) {
+        worklist.Push(item->value());
+      }
+    }
+  }
+}
+
+
+void HIRGen::NumberValues() {
+  static const uint32_t kBuckets = 64;
+  HIRInstructionList table[kBuckets];
+
+  // Dominators are visited first, so equal instruction that dominates
+  // current one (if any) is already in table
+  for (int32_t i = 0; i < order_count_; i++) {
+    HIRBlock* block = order_[i];
+
+    HIRInstructionList::Item* item = block->instructions()->head();
+    while (item != NULL) {
+      HIRInstruction* instr = item->value();
+      item = item->next();
+      if (!instr->is_pure()) continue;
+
+      HIRInstructionList* bucket = &table[instr->Hash() % kBuckets];
+      HIRInstructionList::Item* candidate = bucket->head();
+      for (; candidate != NULL; candidate = candidate->next()) {
+        if (candidate->value()->Equals(instr) &&
+            candidate->value()->block()->Dominates(block)) {
+          break;
+        }
+      }
+
+      if (candidate == NULL) {
+        bucket->Push(instr);
+      } else {
+        instr->ReplaceWith(candidate->value());
+        instr->Remove();
+      }
+    }
+  }
+}
+
+
+void HIRGen::HoistLoopInvariants() {
+  int32_t max_depth = 0;
+  for (int32_t i = 0; i < order_count_; i++) {
+    if (order_[i]->loop_depth() > max_depth) {
+      max_depth = order_[i]->loop_depth();
+    }
+  }
+
+  // Inner loops first, so invariants may travel through several levels
+  for (int32_t depth = max_depth; depth > 0; depth--) {
+    for (int32_t i = 0; i < order_count_; i++) {
+      HIRBlock* header = order_[i];
+      if (!header->is_loop_header() ||
+          header->loop() != header ||
+          header->loop_depth() != depth) {
+        continue;
+      }
+
+      HIRBlock* preheader = PreHeader(header);
+      for (int32_t j = i; j < order_count_; j++) {
+        HIRBlock* block = order_[j];
+        if (!InLoop(block, header)) continue;
+
+        HIRInstructionList::Item* item = block->instructions()->head();
+        while (item != NULL) {
+          HIRInstruction* instr = item->value();
+          HIRInstructionList::Item* current = item;
+          item = item->next();
+
+          // Constants are hoisted too, so instructions using them may follow
+          if (!instr->is_pure()) continue;
+
+          // Speculative instruction moved out of loop restarts it's
+          // outer restart point instead
+          HIRInstruction* snapshot = instr->snapshot();
+          if (snapshot != NULL &&
+              (snapshot->block() != header ||
+               header->outer_restart() == NULL)) {
+            snapshot = NULL;
+          }
+
+          bool invariant = true;
+          HIRInstructionList::Item* input = instr->inputs()->head();
+          for (; invariant && input != NULL; input = input->next()) {
+            if (input->value() == snapshot) continue;
+            invariant = !InLoop(input->value()->block(), header);
+          }
+          if (!invariant) continue;
+
+          if (snapshot != NULL) {
+            instr->ReplaceInput(snapshot, Snapshot(header->outer_restart()));
+          }
+          block->instructions()->Remove(current);
+          preheader->InsertBeforeEnd(instr);
+        }
+      }
+    }
+  }
+}
+
+
+// Instruction is dead if it has no effects and it's result isn't used
+// (phi may use itself)
+static bool IsDead(HIRInstruction* instr) {
+  if (!instr->is_pure() &&
+      !instr->is(HIRInstruction::kPhi) &&
+      !instr->is(HIRInstruction::kAllocateObject) &&
+      !instr->is(HIRInstruction::kSnapshot) &&
+      !instr->is_incoming()) {
+    return false;
+  }
+
+  HIRInstructionList::Item* item = instr->uses()->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() != instr) return false;
+  }
+  return true;
+}
+
+
+void HIRGen::EliminateDeadCode() {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    // Backwards, so uses are usually removed before definitions
+    for (int32_t i = order_count_ - 1; i >= 0; i--) {
+      HIRInstructionList* lists[] = {
+        order_[i]->instructions(), order_[i]->phis()
+      };
+
+      for (int32_t j = 0; j < 2; j++) {
+        HIRInstructionList::Item* item = lists[j]->tail();
+        while (item != NULL) {
+          HIRInstruction* instr = item->value();
+          item = item->prev();
+          if (!IsDead(instr)) continue;
+
+          instr->Remove();
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+
+static uint8_t ConstantType(char* value) {
+  if (value == NULL) return FeedbackSite::kNil;
+  if (HValue::IsUnboxed(value)) return FeedbackSite::kSmi;
+  if (HValue::GetTag(value) == Heap::kTagBoolean) return FeedbackSite::kBoolean;
+  return FeedbackSite::kDouble;
+}
+
+
+static uint8_t InferType(HIRInstruction* instr) {
+  static const uint8_t kNumber = FeedbackSite::kSmi | FeedbackSite::kDouble;
+
+  switch (instr->type()) {
+   case HIRInstruction::kConstant:
+    return ConstantType(instr->value());
+   case HIRInstruction::kNot:
+    return FeedbackSite::kBoolean;
+   case HIRInstruction::kAllocateObject:
+    return FeedbackSite::kObject;
+   case HIRInstruction::kPhi:
+    {
+      uint8_t types = 0;
+      HIRInstructionList::Item* item = instr->inputs()->head();
+      for (; item != NULL; item = item->next()) {
+        types |= item->value()->types();
+      }
+      return types;
+    }
+   case HIRInstruction::kBinOp:
+    {
+      BinOp::BinOpType type = instr->subtype();
+      if (BinOp::is_compare(type)) return FeedbackSite::kBoolean;
+      if (BinOp::is_bitwise(type)) return FeedbackSite::kSmi;
+
+      // Speculative result is unboxed, or code is deoptimized
+      if (instr->is_speculative()) return FeedbackSite::kSmi;
+
+      // Arithmetic on numbers produces numbers
+      uint8_t operands = instr->lhs()->types() | instr->rhs()->types();
+      return (operands & ~kNumber) == 0 ? kNumber : HIRInstruction::kAnyType;
+    }
+   default:
+    return HIRInstruction::kAnyType;
+  }
+}
+
+
+void HIRGen::InferTypes() {
+  // Start with empty sets and iterate to the least fixed point,
+  // so types flow around loops
+  for (int32_t i = 0; i < order_count_; i++) {
+    HIRInstructionList::Item* item = order_[i]->phis()->head();
+    for (; item != NULL; item = item->next()) item->value()->types(0);
+    item = order_[i]->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      if (!item->value()->is_incoming()) {
+        item->value()->types(0);
+      }
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int32_t i = 0; i < order_count_; i++) {
+      HIRInstructionList* lists[] = {
+        order_[i]->phis(), order_[i]->instructions()
+      };
+
+      for (int32_t j = 0; j < 2; j++) {
+        HIRInstructionList::Item* item = lists[j]->head();
+        for (; item != NULL; item = item->next()) {
+          HIRInstruction* instr = item->value();
+          if (instr->is_incoming() || instr->is_control()) {
+            continue;
+          }
+
+          uint8_t types = InferType(instr);
+          if (types == instr->types()) continue;
+
+          instr->types(types);
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+
+void HIRGen::SplitCriticalEdges() {
+  // Moves for phis are placed at the end of predecessor,
+  // so it should have only one successor
+  for (int32_t i = 0; i < order_count_; i++) {
+    HIRBlock* block = order_[i];
+    if (block->successor_count() < 2) continue;
+
+    for (int32_t j = 0; j < block->successor_count(); j++) {
+      HIRBlock* succ = block->successor(j);
+      if (succ->predecessors()->length() < 2) continue;
+
+      HIRBlock* split = CreateBlock();
+      split->sealed(true);
+
+      HIRInstruction* jump = new HIRInstruction(HIRInstruction::kGoto);
+      jump->id(instruction_id_++);
+      split->Append(jump);
+
+      block->successors_[j] = split;
+      succ->ReplacePredecessor(block, split);
+      split->predecessors_.Push(block);
+      split->successors_[split->successor_count_++] = succ;
+    }
+  }
+}
+
+
+bool HIRGen::Print(char* buffer, uint32_t size) {
+  PrintBuffer p(buffer, size);
+
+  for (int32_t i = 0; i < order_count_; i++) {
+    HIRBlock* block = order_[i];
+    if (!p.Print(i == 0 ? "[B%d" : " [B%d", block->id())) return false;
+
+    HIRInstructionList* lists[] = { block->phis(), block->instructions() };
+    for (int32_t j = 0; j < 2; j++) {
+      HIRInstructionList::Item* item = lists[j]->head();
+      for (; item != NULL; item = item->next()) {
+        if (!p.Print(" ") || !item->value()->Print(&p)) return false;
+      }
+    }
+
+    if (!p.Print("]")) return false;
+  }
+  p.Finalize();
+
+  return true;
+}
+
+} // namespace candor
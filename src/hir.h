@@ -0,0 +1,435 @@
+#ifndef _SRC_HIR_H_
+#define _SRC_HIR_H_
+
+//
+// High-level IR of optimizing compiler.
+//
+// HIRGen visits AST of a hot function and builds SSA graph of basic blocks.
+// Values are tagged candor values (the same as fullgen's ones), so graph
+// can be specialized only where feedback or types allow it. Graph is then
+// optimized: redundant phis are removed, pure instructions are numbered
+// (GVN), hoisted out of loops (LICM) and removed if unused (DCE), and
+// types are inferred to eliminate tag checks. LAllocator (see lir.h)
+// assigns registers afterwards.
+//
+// Only functions that keep all their variables on stack and do arithmetic
+// and control flow are supported, HIRGen bails out on everything else.
+//
+// Object literals and loads of their properties are supported only if
+// objects don't escape: loads are replaced by values of properties and
+// objects aren't allocated at all (see ReplaceObjects()). Snapshot may still
+// reference such object, deoptimization materializes it from the values.
+//
+// Graph for on-stack replacement starts at the header of given loop:
+// entry block reads all stack slots from fullgen's frame and code before
+// the loop is unreachable.
+//
+// Binops whose feedback has seen only unboxed numbers are speculative:
+// they have no slow paths and deoptimize if operands aren't unboxed or
+// the result overflows. Optimized code doesn't have side effects, so
+// deoptimization just restarts fullgen's code from the closest restart
+// point that dominates the instruction - function's entry or loop's header.
+// Snapshot keeps values of stack slots at the restart point, speculative
+// instruction uses it as it's last input (so the values stay alive).
+//
+// Small leaf functions are inlined at call sites that have seen only one
+// callee. Callee's variables get environment slots after caller's ones, and
+// CheckTarget guard deoptimizes if variable holds another function.
+//
+
+#include "visitor.h" // Visitor
+#include "ast.h" // AstNode, BinOp
+#include "zone.h" // ZoneObject
+#include "utils.h" // List, PrintBuffer
+
+#include <stdint.h> // uint8_t, uint32_t
+
+namespace candor {
+
+// Forward declarations
+class Heap;
+class FeedbackSite;
+class HIRInstruction;
+class HIRBlock;
+class LInterval;
+
+typedef List<HIRInstruction*, ZoneObject> HIRInstructionList;
+typedef List<HIRBlock*, ZoneObject> HIRBlockList;
+
+class HIRInstruction : public ZoneObject {
+ public:
+  enum Type {
+    kParameter,
+    kOsrValue,
+    kConstant,
+    kPhi,
+    kBinOp,
+    kNot,
+    kLoadContext,
+    kAllocateObject,
+    kLoadProperty,
+    kSnapshot,
+    kCheckTarget,
+
+    // Block terminators
+    kGoto,
+    kBranch,
+    kReturn
+  };
+
+  // Union of FeedbackSite::Type bits
+  static const uint8_t kAnyType = 0xff;
+
+  HIRInstruction(Type type);
+
+  // Inputs keep track of their uses
+  void AddInput(HIRInstruction* input);
+  void ReplaceInput(HIRInstruction* from, HIRInstruction* to);
+
+  // Makes all uses of instruction use `other` instead
+  void ReplaceWith(HIRInstruction* other);
+
+  // Removes instruction from it's block and from inputs' uses
+  void Remove();
+
+  // Pure instructions don't have side effects (stubs they call may only
+  // allocate), so they can be numbered, moved and removed. Optimized code
+  // doesn't call anything that may change variables in contexts.
+  inline bool is_pure() {
+    return type_ == kConstant ||
+           type_ == kBinOp ||
+           type_ == kNot ||
+           type_ == kLoadContext;
+  }
+  inline bool is_control() {
+    return type_ == kGoto || type_ == kBranch || type_ == kReturn;
+  }
+  inline bool is(Type type) { return type_ == type; }
+
+  // Values coming from outside of function's code
+  inline bool is_incoming() {
+    return type_ == kParameter || type_ == kOsrValue;
+  }
+
+  // Value numbering
+  uint32_t Hash();
+  bool Equals(HIRInstruction* other);
+
+  bool Print(PrintBuffer* p);
+
+  inline Type type() { return type_; }
+  inline int32_t id() { return id_; }
+  inline void id(int32_t id) { id_ = id; }
+  inline HIRBlock* block() { return block_; }
+  inline void block(HIRBlock* block) { block_ = block; }
+
+  inline HIRInstructionList* inputs() { return &inputs_; }
+  inline HIRInstructionList* uses() { return &uses_; }
+  inline HIRInstruction* lhs() { return inputs_.head()->value(); }
+  inline HIRInstruction* rhs() { return inputs_.head()->next()->value(); }
+
+  // Snapshot of speculative binop or guard, or NULL
+  inline HIRInstruction* snapshot() {
+    if (inputs_.length() == 0) return NULL;
+
+    HIRInstruction* last = inputs_.tail()->value();
+    return last->is(kSnapshot) ? last : NULL;
+  }
+  inline bool is_speculative() { return snapshot() != NULL; }
+
+  // kBinOp
+  inline BinOp::BinOpType subtype() { return subtype_; }
+  inline void subtype(BinOp::BinOpType subtype) { subtype_ = subtype; }
+  inline FeedbackSite* feedback() { return feedback_; }
+  inline void feedback(FeedbackSite* feedback) { feedback_ = feedback; }
+
+  // kConstant, and kCheckTarget (code address of expected function)
+  inline char* value() { return value_; }
+  inline void value(char* value) { value_ = value; }
+
+  // kSnapshot: function or loop, fullgen's code of which is restarted,
+  // kAllocateObject: object literal (values of properties are inputs),
+  // kLoadProperty: property's name
+  inline AstNode* ast() { return ast_; }
+  inline void ast(AstNode* ast) { ast_ = ast; }
+
+  // kParameter (argument's index), kOsrValue and kPhi (stack slot),
+  // kLoadContext (context slot)
+  inline int32_t index() { return index_; }
+  inline void index(int32_t index) { index_ = index; }
+
+  // kLoadContext: number of contexts to go up, or -1 for global variable's
+  // cell in root context (see ScopeSlot::depth())
+  inline int32_t depth() { return depth_; }
+  inline void depth(int32_t depth) { depth_ = depth; }
+
+  // Types value may have (see FeedbackSite::Type)
+  inline uint8_t types() { return types_; }
+  inline void types(uint8_t types) { types_ = types; }
+  inline bool is_smi() { return types_ == 0x01; }
+
+  // Register allocation
+  inline LInterval* interval() { return interval_; }
+  inline void interval(LInterval* interval) { interval_ = interval; }
+  inline int32_t pos() { return pos_; }
+  inline void pos(int32_t pos) { pos_ = pos; }
+
+ protected:
+  Type type_;
+  int32_t id_;
+  HIRBlock* block_;
+
+  HIRInstructionList inputs_;
+  HIRInstructionList uses_;
+
+  BinOp::BinOpType subtype_;
+  FeedbackSite* feedback_;
+  char* value_;
+  AstNode* ast_;
+  int32_t index_;
+  int32_t depth_;
+  uint8_t types_;
+
+  LInterval* interval_;
+  int32_t pos_;
+};
+
+class HIRBlock : public ZoneObject {
+ public:
+  HIRBlock(int32_t id, int32_t slots);
+
+  void Append(HIRInstruction* instr);
+
+  // Inserts instruction before block's terminator
+  void InsertBeforeEnd(HIRInstruction* instr);
+
+  // Links blocks in CFG, if block is a sealed loop header -
+  // values of phis are taken from predecessor's environment
+  void AddPredecessor(HIRBlock* pred);
+  void ReplacePredecessor(HIRBlock* from, HIRBlock* to);
+  void ReplaceSuccessor(HIRBlock* from, HIRBlock* to);
+  int32_t PredecessorIndex(HIRBlock* pred);
+
+  // Returns true if block is `other` or dominates it
+  bool Dominates(HIRBlock* other);
+
+  inline HIRInstruction* last() {
+    return instructions_.tail() == NULL ? NULL : instructions_.tail()->value();
+  }
+  inline bool is_terminated() {
+    return last() != NULL && last()->is_control();
+  }
+
+  inline int32_t id() { return id_; }
+  inline HIRInstructionList* instructions() { return &instructions_; }
+  inline HIRInstructionList* phis() { return &phis_; }
+  inline HIRBlockList* predecessors() { return &predecessors_; }
+  inline HIRBlock* successor(int32_t i) { return successors_[i]; }
+  inline int32_t successor_count() { return successor_count_; }
+
+  // Values of stack slots at the block's end (during graph building)
+  inline HIRInstruction** env() { return env_; }
+  inline int32_t slots() { return slots_; }
+
+  inline bool is_loop_header() { return loop_header_; }
+  inline void loop_header(bool value) { loop_header_ = value; }
+  inline bool is_sealed() { return sealed_; }
+  inline void sealed(bool value) { sealed_ = value; }
+
+  inline HIRBlock* dominator() { return dominator_; }
+  inline void dominator(HIRBlock* dominator) { dominator_ = dominator; }
+  inline int32_t rpo() { return rpo_; }
+  inline void rpo(int32_t rpo) { rpo_ = rpo; }
+  inline int32_t loop_depth() { return loop_depth_; }
+  inline void loop_depth(int32_t depth) { loop_depth_ = depth; }
+
+  // Restart point of deoptimization: function's entry or loop's header,
+  // `restart` is a function or a loop node
+  inline AstNode* restart() { return restart_; }
+  inline void restart(AstNode* restart) { restart_ = restart; }
+  inline HIRBlock* outer_restart() { return outer_restart_; }
+  inline void outer_restart(HIRBlock* outer) { outer_restart_ = outer; }
+
+  // Header of innermost loop containing block
+  inline HIRBlock* loop() { return loop_; }
+  inline void loop(HIRBlock* loop) { loop_ = loop; }
+
+  // Linear positions of block's boundaries (see LAllocator)
+  inline int32_t start() { return start_; }
+  inline void start(int32_t start) { start_ = start; }
+  inline int32_t end() { return end_; }
+  inline void end(int32_t end) { end_ = end; }
+
+  // Live values at block's start, bitmap indexed by instruction's id
+  inline uint32_t* live_in() { return live_in_; }
+  inline void live_in(uint32_t* live_in) { live_in_ = live_in; }
+
+ protected:
+  int32_t id_;
+
+  HIRInstructionList instructions_;
+  HIRInstructionList phis_;
+  HIRBlockList predecessors_;
+  HIRBlock* successors_[2];
+  int32_t successor_count_;
+
+  HIRInstruction** env_;
+  int32_t slots_;
+
+  bool loop_header_;
+  bool sealed_;
+
+  HIRBlock* dominator_;
+  int32_t rpo_;
+  int32_t loop_depth_;
+  HIRBlock* loop_;
+
+  AstNode* restart_;
+  HIRBlock* outer_restart_;
+  HIRInstruction* snapshot_;
+
+  int32_t start_;
+  int32_t end_;
+  uint32_t* live_in_;
+
+  friend class HIRGen;
+};
+
+class HIRGen : public Visitor {
+ public:
+  HIRGen(Heap* heap, AstNode* fn, AstNode* osr = NULL);
+
+  // Maximum number of AST nodes in inlined function
+  static const int32_t kMaxInlineSize = 48;
+
+  // Builds SSA graph, returns false if function can't be optimized
+  bool Build();
+
+  // Runs all optimization passes, returns false if function can't be
+  // optimized after all
+  bool Optimize();
+
+  AstNode* VisitFunction(AstNode* node);
+  AstNode* VisitCall(AstNode* node);
+  AstNode* VisitBlock(AstNode* node);
+  AstNode* VisitScopeDecl(AstNode* node);
+  AstNode* VisitIf(AstNode* node);
+  AstNode* VisitWhile(AstNode* node);
+  AstNode* VisitAssign(AstNode* node);
+  AstNode* VisitMember(AstNode* node);
+  AstNode* VisitValue(AstNode* node);
+  AstNode* VisitNumber(AstNode* node);
+  AstNode* VisitObjectLiteral(AstNode* node);
+  AstNode* VisitArrayLiteral(AstNode* node);
+  AstNode* VisitNil(AstNode* node);
+  AstNode* VisitTrue(AstNode* node);
+  AstNode* VisitFalse(AstNode* node);
+  AstNode* VisitReturn(AstNode* node);
+  AstNode* VisitProperty(AstNode* node);
+  AstNode* VisitString(AstNode* node);
+  AstNode* VisitUnOp(AstNode* node);
+  AstNode* VisitBinOp(AstNode* node);
+
+  bool Print(char* buffer, uint32_t size);
+
+  inline Heap* heap() { return heap_; }
+  inline FunctionLiteral* fn() { return fn_; }
+  inline AstNode* osr() { return osr_; }
+
+  // Blocks in reverse post order (after Optimize())
+  inline HIRBlock** blocks() { return order_; }
+  inline int32_t block_count() { return order_count_; }
+  inline int32_t instruction_count() { return instruction_id_; }
+
+ protected:
+  HIRInstruction* VisitForValue(AstNode* node);
+  void VisitStatements(AstNode* node);
+
+  // Builds branches to `is_true` and `is_false` blocks
+  void VisitForControl(AstNode* node, HIRBlock* is_true, HIRBlock* is_false);
+
+  // Bails out of optimization, returns nil value to continue visiting
+  HIRInstruction* Bailout();
+
+  // Returns index of on-stack variable (in inlined function's slots if
+  // it's being visited) or -1
+  int32_t StackIndex(AstNode* node);
+
+  // Returns function literal of call's only callee if it can be inlined,
+  // or NULL
+  FunctionLiteral* InlineTarget(AstNode* call);
+
+  // Number of stack slots needed by functions inlined into `node`
+  int32_t InlinedSlots(AstNode* node);
+
+  // Visits body of callee with given arguments in place of call,
+  // returns call's result
+  HIRInstruction* Inline(FunctionLiteral* callee,
+                         HIRInstruction** args,
+                         int32_t argc);
+
+  HIRBlock* CreateBlock();
+  HIRInstruction* Add(HIRInstruction* instr);
+  HIRInstruction* AddConstant(char* value);
+  HIRInstruction* AddBinOp(BinOp::BinOpType type,
+                           HIRInstruction* lhs,
+                           HIRInstruction* rhs,
+                           FeedbackSite* feedback);
+  HIRInstruction* AddPhi(HIRBlock* block, int32_t slot);
+
+  // Returns snapshot of restart point, creates it on first use
+  HIRInstruction* Snapshot(HIRBlock* restart);
+
+  // Terminators
+  void Goto(HIRBlock* target);
+  void Branch(HIRInstruction* value, HIRBlock* is_true, HIRBlock* is_false);
+  void Return(HIRInstruction* value);
+
+  // Starts emitting into the block, merges environments of predecessors
+  void SetCurrent(HIRBlock* block);
+
+  // Optimization passes
+  void RemoveUnreachable();
+  void RemoveTrivialPhis();
+  bool ReplaceObjects();
+  void ComputeOrder();
+  void ComputeDominators();
+  void FindLoops();
+  void NumberValues();
+  void HoistLoopInvariants();
+  void EliminateDeadCode();
+  void InferTypes();
+  void SplitCriticalEdges();
+
+  Heap* heap_;
+  FunctionLiteral* fn_;
+  AstNode* osr_;
+  bool bailout_;
+
+  HIRBlock* entry_;
+  HIRBlock* current_;
+  HIRInstruction* value_;
+  HIRInstruction* nil_;
+  int32_t slots_;
+
+  // Closest restart point that dominates current block, or NULL
+  HIRBlock* restart_;
+
+  // Function being inlined (or NULL), first of it's slots, block where
+  // it's returns are jumping and values they return (in order of jumps)
+  FunctionLiteral* inlined_;
+  int32_t inlined_base_;
+  HIRBlock* inlined_exit_;
+  HIRInstructionList inlined_values_;
+
+  HIRBlockList blocks_;
+  int32_t block_id_;
+  int32_t instruction_id_;
+
+  HIRBlock** order_;
+  int32_t order_count_;
+};
+
+} // namespace candor
+
+#endif // _SRC_HIR_H_
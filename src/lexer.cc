@@ -172,6 +172,7 @@ Lexer::Token* Lexer::Consume() {
     if (has(3)) {
       MATH_THREE('=', '=', '=', kStrictEq)
       MATH_THREE('!', '=', '=', kStrictNe)
+      MATH_THREE('>', '>', '>', kUShr)
     }
 
     // Two char ops
@@ -184,12 +185,15 @@ Lexer::Token* Lexer::Consume() {
       MATH_TWO('!', '=', kNe)
       MATH_TWO('|', '|', kLOr)
       MATH_TWO('&', '&', kLAnd)
+      MATH_TWO('<', '<', kShl)
+      MATH_TWO('>', '>', kShr)
     }
 
     MATH_ONE('+', kAdd)
     MATH_ONE('-', kSub)
     MATH_ONE('/', kDiv)
     MATH_ONE('*', kMul)
+    MATH_ONE('%', kMod)
     MATH_ONE('<', kLt)
     MATH_ONE('>', kGt)
     MATH_ONE('!', kNot)
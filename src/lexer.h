@@ -37,9 +37,13 @@ class Lexer {
     kSub,
     kDiv,
     kMul,
+    kMod,
     kBAnd,
     kBOr,
     kBXor,
+    kShl,
+    kShr,
+    kUShr,
 
     // Logic
     kEq,
@@ -0,0 +1,304 @@
+#include "lir.h"
+#include "hir.h" // HIRGen, HIRInstruction, HIRBlock
+#include "zone.h" // Zone
+#include "utils.h" // List
+
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL
+#include <string.h> // memset, memcpy, memcmp
+
+namespace candor {
+
+LAllocator::LAllocator(HIRGen* hir, int32_t registers) : hir_(hir),
+                                                        registers_(registers),
+                                                        spill_count_(0),
+                                                        live_out_(NULL),
+                                                        words_(0) {
+}
+
+
+void LAllocator::Allocate() {
+  ComputePositions();
+  ComputeLiveness();
+  BuildIntervals();
+  LinearScan();
+}
+
+
+// Only non-constant values need locations (guards don't have a value,
+// and objects that don't escape aren't allocated)
+static inline bool HasInterval(HIRInstruction* instr) {
+  return !instr->is_control() &&
+         !instr->is(HIRInstruction::kConstant) &&
+         !instr->is(HIRInstruction::kAllocateObject) &&
+         !instr->is(HIRInstruction::kSnapshot) &&
+         !instr->is(HIRInstruction::kCheckTarget);
+}
+
+
+void LAllocator::ComputePositions() {
+  int32_t pos = 0;
+
+  for (int32_t i = 0; i < hir_->block_count(); i++) {
+    HIRBlock* block = hir_->blocks()[i];
+    block->start(pos);
+
+    HIRInstructionList::Item* item = block->phis()->head();
+    for (; item != NULL; item = item->next()) item->value()->pos(pos);
+    pos += 2;
+
+    item = block->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      item->value()->pos(pos);
+      pos += 2;
+    }
+
+    // Position of terminator
+    block->end(pos - 2);
+  }
+}
+
+
+static inline void SetBit(uint32_t* bits, int32_t index) {
+  bits[index >> 5] |= 1 << (index & 31);
+}
+
+
+static inline void ClearBit(uint32_t* bits, int32_t index) {
+  bits[index >> 5] &= ~(1 << (index & 31));
+}
+
+
+static inline bool HasBit(uint32_t* bits, int32_t index) {
+  return (bits[index >> 5] & (1 << (index & 31))) != 0;
+}
+
+
+void LAllocator::ComputeLiveness() {
+  int32_t count = hir_->block_count();
+  HIRBlock** blocks = hir_->blocks();
+
+  words_ = (hir_->instruction_count() + 31) >> 5;
+  live_out_ = Zone::NewArray<uint32_t*>(count);
+  for (int32_t i = 0; i < count; i++) {
+    live_out_[i] = Zone::NewArray<uint32_t>(words_);
+    blocks[i]->live_in(Zone::NewArray<uint32_t>(words_));
+  }
+
+  uint32_t* live = Zone::NewArray<uint32_t>(words_);
+
+  // Iterate backwards until nothing changes (loops need several passes)
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int32_t i = count - 1; i >= 0; i--) {
+      HIRBlock* block = blocks[i];
+      memset(live, 0, words_ * sizeof(*live));
+
+      for (int32_t j = 0; j < block->successor_count(); j++) {
+        HIRBlock* succ = block->successor(j);
+        for (int32_t k = 0; k < words_; k++) live[k] |= succ->live_in()[k];
+
+        // Phis' inputs are used at the end of predecessor
+        int32_t index = succ->PredecessorIndex(block);
+        HIRInstructionList::Item* item = succ->phis()->head();
+        for (; item != NULL; item = item->next()) {
+          HIRInstructionList::Item* input = item->value()->inputs()->head();
+          for (int32_t k = 0; k < index; k++) input = input->next();
+
+          if (HasInterval(input->value())) SetBit(live, input->value()->id());
+        }
+      }
+      memcpy(live_out_[i], live, words_ * sizeof(*live));
+
+      HIRInstructionList::Item* item = block->instructions()->tail();
+      for (; item != NULL; item = item->prev()) {
+        HIRInstruction* instr = item->value();
+        ClearBit(live, instr->id());
+
+        HIRInstructionList::Item* input = instr->inputs()->head();
+        for (; input != NULL; input = input->next()) {
+          if (HasInterval(input->value())) SetBit(live, input->value()->id());
+        }
+
+        // Deoptimization reads values of snapshot, and values of properties
+        // of objects it materializes
+        if (!instr->is_speculative()) continue;
+        input = instr->snapshot()->inputs()->head();
+        for (; input != NULL; input = input->next()) {
+          HIRInstruction* value = input->value();
+          if (HasInterval(value)) SetBit(live, value->id());
+          if (!value->is(HIRInstruction::kAllocateObject)) continue;
+
+          HIRInstructionList::Item* prop = value->inputs()->head();
+          for (; prop != NULL; prop = prop->next()) {
+            if (HasInterval(prop->value())) SetBit(live, prop->value()->id());
+          }
+        }
+      }
+
+      item = block->phis()->head();
+      for (; item != NULL; item = item->next()) {
+        ClearBit(live, item->value()->id());
+      }
+
+      if (memcmp(block->live_in(), live, words_ * sizeof(*live)) != 0) {
+        memcpy(block->live_in(), live, words_ * sizeof(*live));
+        changed = true;
+      }
+    }
+  }
+}
+
+
+void LAllocator::Use(HIRInstruction* value, int32_t pos) {
+  LInterval* interval = value->interval();
+  if (interval == NULL) return;
+
+  if (interval->start() > pos) interval->start(pos);
+  if (interval->end() < pos) interval->end(pos);
+}
+
+
+void LAllocator::BuildIntervals() {
+  int32_t count = hir_->block_count();
+  HIRBlock** blocks = hir_->blocks();
+
+  // Every value starts at it's definition
+  HIRInstruction** values = Zone::NewArray<HIRInstruction*>(
+      hir_->instruction_count());
+  for (int32_t i = 0; i < count; i++) {
+    HIRInstructionList* lists[] = {
+      blocks[i]->phis(), blocks[i]->instructions()
+    };
+
+    for (int32_t j = 0; j < 2; j++) {
+      HIRInstructionList::Item* item = lists[j]->head();
+      for (; item != NULL; item = item->next()) {
+        HIRInstruction* instr = item->value();
+        if (!HasInterval(instr)) continue;
+
+        instr->interval(new LInterval(instr, instr->pos(), instr->pos()));
+        values[instr->id()] = instr;
+      }
+    }
+  }
+
+  for (int32_t i = 0; i < count; i++) {
+    HIRBlock* block = blocks[i];
+
+    // Values live after the block are kept until it's end
+    for (int32_t j = 0; j < hir_->instruction_count(); j++) {
+      if (HasBit(live_out_[i], j)) Use(values[j], block->end());
+    }
+
+    HIRInstructionList::Item* item = block->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      HIRInstruction* instr = item->value();
+      HIRInstructionList::Item* input = instr->inputs()->head();
+      for (; input != NULL; input = input->next()) {
+        Use(input->value(), instr->pos());
+      }
+
+      // Snapshot's values are read after instruction's operands, so they
+      // don't share registers with it's result
+      if (!instr->is_speculative()) continue;
+      input = instr->snapshot()->inputs()->head();
+      for (; input != NULL; input = input->next()) {
+        Use(input->value(), instr->pos() + 1);
+        if (!input->value()->is(HIRInstruction::kAllocateObject)) continue;
+
+        HIRInstructionList::Item* prop = input->value()->inputs()->head();
+        for (; prop != NULL; prop = prop->next()) {
+          Use(prop->value(), instr->pos() + 1);
+        }
+      }
+    }
+
+    // Phi's location is written at the end of each predecessor,
+    // so it's reserved there too
+    item = block->phis()->head();
+    for (; item != NULL; item = item->next()) {
+      HIRBlockList::Item* pred = block->predecessors()->head();
+      for (; pred != NULL; pred = pred->next()) {
+        Use(item->value(), pred->value()->end());
+      }
+    }
+  }
+
+  // Sort by start
+  for (int32_t i = 0; i < count; i++) {
+    HIRInstructionList* lists[] = {
+      blocks[i]->phis(), blocks[i]->instructions()
+    };
+
+    for (int32_t j = 0; j < 2; j++) {
+      HIRInstructionList::Item* item = lists[j]->head();
+      for (; item != NULL; item = item->next()) {
+        LInterval* interval = item->value()->interval();
+        if (interval == NULL) continue;
+
+        LIntervalList::Item* next = intervals_.tail();
+        while (next != NULL && next->value()->start() > interval->start()) {
+          next = next->prev();
+        }
+        intervals_.InsertBefore(next == NULL ? intervals_.head() : next->next(),
+                                interval);
+      }
+    }
+  }
+}
+
+
+void LAllocator::LinearScan() {
+  LIntervalList active;
+  bool* used = Zone::NewArray<bool>(registers_);
+
+  LIntervalList::Item* item = intervals_.head();
+  for (; item != NULL; item = item->next()) {
+    LInterval* current = item->value();
+
+    // Expire intervals that ended before current one,
+    // values used by instruction may share register with it's result
+    LIntervalList::Item* a = active.head();
+    while (a != NULL && a->value()->end() <= current->start()) {
+      used[a->value()->reg()] = false;
+      active.Shift();
+      a = active.head();
+    }
+
+    int32_t reg = -1;
+    for (int32_t i = 0; i < registers_; i++) {
+      if (used[i]) continue;
+      reg = i;
+      break;
+    }
+
+    LInterval* spill = current;
+    if (reg == -1) {
+      // Spill interval that ends last
+      LInterval* last = active.tail()->value();
+      if (last->end() > current->end()) {
+        reg = last->reg();
+        last->reg(-1);
+        active.Remove(active.tail());
+        spill = last;
+      }
+    }
+
+    if (reg != -1) {
+      current->reg(reg);
+      used[reg] = true;
+
+      // Keep active list sorted by end
+      a = active.tail();
+      while (a != NULL && a->value()->end() > current->end()) a = a->prev();
+      active.InsertBefore(a == NULL ? active.head() : a->next(), current);
+    }
+
+    if (spill != current || reg == -1) spill->spill(spill_count_++);
+  }
+}
+
+} // namespace candor
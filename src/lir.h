@@ -0,0 +1,234 @@
+#ifndef _SRC_LIR_H_
+#define _SRC_LIR_H_
+
+//
+// Low-level part of optimizing compiler.
+//
+// LAllocator linearizes blocks of HIR graph, computes liveness of values and
+// assigns registers to them using linear scan (Poletto & Sarkar). Every value
+// gets one interval covering all it's uses, intervals that don't fit into
+// registers are spilled to stack for their whole lifetime. Constants are
+// rematerialized at uses and don't occupy registers at all.
+//
+// LGen walks blocks in the same order and emits machine code through Masm.
+// Fast paths for types seen in feedback are inlined, everything else goes
+// to stubs in deferred code placed after function's body. Speculative
+// instructions jump to deoptimization code instead, it writes snapshot's
+// values into fullgen's stack slots and continues in fullgen's code.
+//
+
+#include "hir.h" // HIRGen, HIRInstruction, HIRBlock
+#include "zone.h" // ZoneObject
+#include "utils.h" // List
+
+#if __ARCH == x64
+#include "x64/macroassembler-x64.h"
+#include "x64/macroassembler-x64-inl.h"
+#else
+#include "ia32/macroassembler-ia32.h"
+#endif
+
+#include <stdint.h> // int32_t
+
+namespace candor {
+
+// Forward declarations
+class Heap;
+class FFunction;
+class BaseStub;
+class FeedbackVector;
+
+class LInterval : public ZoneObject {
+ public:
+  LInterval(HIRInstruction* value, int32_t start, int32_t end)
+      : value_(value), start_(start), end_(end), reg_(-1), spill_(-1) {
+  }
+
+  inline HIRInstruction* value() { return value_; }
+  inline int32_t start() { return start_; }
+  inline void start(int32_t start) { start_ = start; }
+  inline int32_t end() { return end_; }
+  inline void end(int32_t end) { end_ = end; }
+
+  // Index of allocatable register (see LGen), or -1
+  inline int32_t reg() { return reg_; }
+  inline void reg(int32_t reg) { reg_ = reg; }
+  inline bool is_register() { return reg_ != -1; }
+
+  // Index of stack slot, or -1
+  inline int32_t spill() { return spill_; }
+  inline void spill(int32_t spill) { spill_ = spill; }
+
+  // Value is in interval's location at `pos` and will be used after it
+  inline bool is_live(int32_t pos) { return start_ < pos && end_ > pos; }
+
+ protected:
+  HIRInstruction* value_;
+  int32_t start_;
+  int32_t end_;
+  int32_t reg_;
+  int32_t spill_;
+};
+
+typedef List<LInterval*, ZoneObject> LIntervalList;
+
+class LAllocator {
+ public:
+  LAllocator(HIRGen* hir, int32_t registers);
+
+  void Allocate();
+
+  inline LIntervalList* intervals() { return &intervals_; }
+  inline int32_t spill_count() { return spill_count_; }
+
+ protected:
+  // Assigns linear positions to blocks and instructions,
+  // instructions are two positions apart, phis are at block's start
+  void ComputePositions();
+  void ComputeLiveness();
+  void BuildIntervals();
+  void LinearScan();
+
+  // Extends interval of `value` to cover `pos`
+  void Use(HIRInstruction* value, int32_t pos);
+
+  HIRGen* hir_;
+  int32_t registers_;
+  int32_t spill_count_;
+
+  // Bitmaps of values live at blocks' ends (indexed by rpo)
+  uint32_t** live_out_;
+  int32_t words_;
+
+  // Sorted by start
+  LIntervalList intervals_;
+};
+
+// Out-of-line code of instruction: slow path of binop, truthiness check
+// or deoptimization to snapshot (shared by all speculative instructions
+// that use it)
+class LDeferred : public ZoneObject {
+ public:
+  enum Kind {
+    kBinOp,
+    kCoerce,
+    kDeopt
+  };
+
+  LDeferred(Kind kind, HIRInstruction* instr, int32_t pos)
+      : entry_(NULL),
+        exit_(NULL),
+        is_true_(NULL),
+        is_false_(NULL),
+        kind_(kind),
+        instr_(instr),
+        pos_(pos) {
+  }
+
+  inline Kind kind() { return kind_; }
+  inline HIRInstruction* instr() { return instr_; }
+  inline int32_t pos() { return pos_; }
+
+  // Deferred code starts at `entry` and jumps back to `exit`,
+  // or to `is_true`/`is_false` if it's a part of branch
+  Label* entry_;
+  Label* exit_;
+  Label* is_true_;
+  Label* is_false_;
+
+ protected:
+  Kind kind_;
+  HIRInstruction* instr_;
+  int32_t pos_;
+};
+
+// Generates optimized code from allocated HIR
+class LGen : public Masm {
+ public:
+  LGen(Heap* heap,
+       HIRGen* hir,
+       LAllocator* allocator,
+       FeedbackVector* vector);
+  ~LGen();
+
+  // Number of registers available to allocator
+  static const int32_t kRegisterCount = 9;
+
+  void Generate();
+
+ protected:
+  void GeneratePrologue();
+  void GenerateEpilogue();
+
+  // Takes over fullgen's frame at loop's header (see HIRGen::osr())
+  void GenerateOsrPrologue();
+
+  void VisitInstruction(HIRInstruction* instr, HIRBlock* next);
+  void VisitBinOp(HIRInstruction* instr, Label* is_true, Label* is_false);
+  void VisitNot(HIRInstruction* instr);
+  void VisitLoadContext(HIRInstruction* instr);
+  void VisitCheckTarget(HIRInstruction* instr);
+  void VisitGoto(HIRInstruction* instr, HIRBlock* next);
+  void VisitBranch(HIRInstruction* instr, HIRBlock* next);
+  void VisitReturn(HIRInstruction* instr);
+
+  void GenerateDeferred(LDeferred* deferred);
+
+  // Rebuilds fullgen's frame at snapshot's restart point and jumps there
+  void GenerateDeopt(HIRInstruction* snapshot);
+
+  // Returns entry of deoptimization code of snapshot
+  Label* DeoptLabel(HIRInstruction* snapshot);
+
+  // Jumps to `is_true` or `is_false` depending on truthiness of rax
+  void BranchOnValue(HIRInstruction* value,
+                     int32_t pos,
+                     Label* is_true,
+                     Label* is_false);
+
+  // Moves values of phis' inputs into phis' locations,
+  // moves are parallel, i.e. all sources are read before they're overwritten
+  void MovePhis(HIRBlock* from, HIRBlock* to);
+
+  // Values' locations
+  void Load(HIRInstruction* value, Register dst);
+  void Store(Register src, HIRInstruction* value);
+  Register RegisterOf(LInterval* interval);
+
+  // Keeps values that are live at `pos` on stack, so GC will see them
+  void SaveLive(int32_t pos);
+  void RestoreLive(int32_t pos);
+
+  // Stub(rax, rcx), result in rax
+  void CallBinOpStub(BinOp::BinOpType type, int32_t pos);
+
+  Label* NewLabel();
+  Label* BlockLabel(HIRBlock* block);
+
+  HIRGen* hir_;
+  LAllocator* allocator_;
+  FeedbackVector* vector_;
+
+  // Frame starts with fullgen's stack slots (so on-stack replacement and
+  // deoptimization keep variables in place), context, arguments count and
+  // register arguments for deoptimization follow them, and spill slots are
+  // the last
+  static const int32_t kContextSlot = 0;
+  static const int32_t kArgcSlot = 1;
+  static const int32_t kArgumentSlot = 2;
+  static const int32_t kSavedSlots = kArgumentSlot + Masm::kArgRegisterCount;
+  inline int32_t SavedSlotOffset(int32_t index) {
+    return -8 * (hir_->fn()->stack_slots() + index + 1);
+  }
+  int32_t spill_base_;
+
+  // Labels of blocks (indexed by rpo)
+  Label** blocks_;
+  List<Label*, EmptyClass> labels_;
+  List<LDeferred*, ZoneObject> deferred_;
+  List<FFunction*, ZoneObject> fns_;
+};
+
+} // namespace candor
+
+#endif // _SRC_LIR_H_
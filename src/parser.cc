@@ -113,33 +113,41 @@ AstNode* Parser::ParseStatement() {
 
 
 #define BINOP_PRI1\
+    case kLOr:
+
+#define BINOP_PRI2\
+    case kLAnd:
+
+#define BINOP_PRI3\
     case kEq:\
     case kNe:\
     case kStrictEq:\
     case kStrictNe:
 
-#define BINOP_PRI2\
+#define BINOP_PRI4\
     case kLt:\
     case kGt:\
     case kLe:\
     case kGe:
 
-#define BINOP_PRI3\
-    case kLOr:\
-    case kLAnd:
-
-#define BINOP_PRI4\
+#define BINOP_PRI5\
     case kBOr:\
     case kBAnd:\
     case kBXor:
 
-#define BINOP_PRI5\
+#define BINOP_PRI6\
+    case kShl:\
+    case kShr:\
+    case kUShr:
+
+#define BINOP_PRI7\
     case kAdd:\
     case kSub:
 
-#define BINOP_PRI6\
+#define BINOP_PRI8\
     case kMul:\
-    case kDiv:
+    case kDiv:\
+    case kMod:
 
 #define BINOP_SWITCH(type, result, priority, K)\
     type = Peek()->type();\
@@ -154,6 +162,7 @@ AstNode* Parser::ParseStatement() {
 
 AstNode* Parser::ParseExpression(int priority) {
   AstNode* result = NULL;
+  ResetSign r(this, priority == 0);
 
   // Parse prefix unops and block expression
   switch (Peek()->type()) {
@@ -263,6 +272,12 @@ AstNode* Parser::ParseExpression(int priority) {
       BINOP_SWITCH(type, result, 5, BINOP_PRI5)
      case 6:
       BINOP_SWITCH(type, result, 6, BINOP_PRI6)
+     case 7:
+      BINOP_SWITCH(type, result, 7, BINOP_PRI7)
+     case 8:
+      BINOP_SWITCH(type, result, 8, BINOP_PRI8)
+     case 9:
+      break;
     }
   } while (initial != result);
 
@@ -280,7 +295,7 @@ AstNode* Parser::ParsePrefixUnOp(TokenType type) {
   {
     NegateSign n(this, type);
 
-    expr = ParseExpression();
+    expr = ParseExpression(1);
   }
 
   if (expr == NULL) return NULL;
@@ -299,7 +314,13 @@ AstNode* Parser::ParseBinOp(TokenType type, AstNode* lhs, int priority) {
   {
     NegateSign n(this, type);
 
-    rhs = ParseExpression(priority);
+    // `a - b + c` is parsed as `a - (b - c)`, other binops are
+    // left associative
+    if (type == kAdd || type == kSub) {
+      rhs = ParseExpression(priority);
+    } else {
+      rhs = ParseExpression(priority + 1);
+    }
   }
 
   if (rhs == NULL) return NULL;
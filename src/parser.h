@@ -72,6 +72,22 @@ class Parser : public Lexer {
     ParserSign sign_;
   };
 
+  // Nested expressions (parens, call arguments and etc) shouldn't be
+  // affected by the sign of outer expression
+  class ResetSign {
+   public:
+    ResetSign(Parser* p, bool reset) : p_(p), sign_(p->sign_) {
+      if (reset) p_->sign_ = kNormal;
+    }
+
+    ~ResetSign() {
+      p_->sign_ = sign_;
+    }
+   private:
+    Parser* p_;
+    ParserSign sign_;
+  };
+
   // Creates new ast node and inserts `original` as it's child
   inline AstNode* Wrap(AstNode::Type type, AstNode* original) {
     AstNode* wrap = new AstNode(type);
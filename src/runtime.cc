@@ -1,10 +1,16 @@
 #include "runtime.h"
 #include "heap.h" // Heap
+#include "feedback.h" // FeedbackVector
+#include "hir.h" // HIRGen
+#include "lir.h" // LAllocator, LGen
+#include "compiler.h" // Guard
+#include "zone.h" // Zone
 #include "utils.h" // ComputeHash, etc
 
 #include <stdint.h> // uint32_t
 #include <assert.h> // assert
-#include <string.h> // strncmp
+#include <string.h> // strncmp, memcmp
+#include <math.h> // NAN
 #include <stdio.h> // snprintf
 #include <sys/types.h> // size_t
 
@@ -23,90 +29,241 @@ void RuntimeCollectGarbage(Heap* heap, char* stack_top) {
 }
 
 
+// Compiles function with optimizing compiler, returns NULL if it can't be
+// optimized. If `osr` loop is given - code is entered at loop's header.
+static Guard* Optimize(Heap* heap, FeedbackVector* vector, AstNode* osr) {
+  Zone optimizer_zone;
+
+  HIRGen hir(heap, vector->fn(), osr);
+  if (!hir.Build() || !hir.Optimize()) {
+    vector->DisableOptimization();
+    return NULL;
+  }
+
+  LAllocator allocator(&hir, LGen::kRegisterCount);
+  allocator.Allocate();
+
+  LGen gen(heap, &hir, &allocator, vector);
+  gen.Generate();
+
+  Guard* guard = new Guard(gen.buffer(), gen.length());
+  gen.Relocate(guard->buffer());
+
+  return guard;
+}
+
+
+char* RuntimeOptimize(Heap* heap, FeedbackVector* vector) {
+  Guard* guard = Optimize(heap, vector, NULL);
+  if (guard == NULL) return NULL;
+
+  vector->Optimized(guard, guard->buffer());
+
+  return guard->buffer();
+}
+
+
+char* RuntimeOsr(Heap* heap, FeedbackVector* vector, AstNode* loop) {
+  char* entry = vector->OsrEntry(loop);
+  if (entry != NULL) return entry;
+
+  Guard* guard = Optimize(heap, vector, loop);
+  if (guard == NULL) return NULL;
+
+  return vector->OsrCompiled(loop, guard, guard->buffer());
+}
+
+
+void RuntimeDeoptimize(Heap* heap, FeedbackVector* vector) {
+  vector->Deoptimized();
+}
+
+
+// Writes string representation of number into buffer, returns length
+static uint32_t NumberToString(char* value, char* buffer, uint32_t size) {
+  if (HValue::IsUnboxed(value)) {
+    return IntToString(HNumber::Untag(reinterpret_cast<int64_t>(value)),
+                       buffer);
+  }
+
+  double num = *reinterpret_cast<double*>(value + 8);
+  return snprintf(buffer, size, "%g", num);
+}
+
+
+// Finds (or creates if `insert` is true) interned string for numeric key,
+// returns NULL if there're no such string
+static char* NumberToKey(Heap* heap, char* number, off_t insert) {
+  bool unboxed = HValue::IsUnboxed(number);
+  if (unboxed) {
+    char* cached = heap->GetNumberString(number);
+    if (cached != NULL) return cached;
+  }
+
+  // No heap allocation here - just format number on stack
+  char str[128];
+  uint32_t length = NumberToString(number, str, sizeof(str));
+
+  char* result;
+  if (insert) {
+    result = heap->string_table()->Intern(str, length, false);
+  } else {
+    result = heap->string_table()->Lookup(
+        str, length, ComputeHash(str, length, heap->hash_seed()));
+  }
+
+  if (result != NULL && unboxed) heap->SetNumberString(number, result);
+
+  return result;
+}
+
+
+// Walks map's space from key's hash position, returns first entry that
+// holds `key` or is empty
+static inline char* FindEntry(char* space,
+                              uint32_t mask,
+                              uint32_t hash,
+                              char* key) {
+  uint32_t index = hash & mask;
+  while (true) {
+    char* entry_key = *reinterpret_cast<char**>(space + index);
+    if (entry_key == NULL || entry_key == key) break;
+    index = (index + 16) & mask;
+  }
+
+  return space + index;
+}
+
+
 char* RuntimeLookupProperty(Heap* heap,
                             char* stack_top,
                             char* obj,
                             char* key,
                             off_t insert) {
+  char* strkey;
+
+  // All keys in maps are interned, so they can be compared by address.
+  // If key wasn't interned yet - it's not present in any object.
+  if (HValue::GetTag(key) == Heap::kTagNumber) {
+    strkey = NumberToKey(heap, key, insert);
+  } else {
+    // NOTE: Conversion should not trigger GC, because `obj` may be moved
+    strkey = RuntimeToString(heap, NULL, key);
+
+    if (insert) {
+      strkey = heap->string_table()->Intern(strkey);
+    } else if (!HValue::IsImmortal(strkey)) {
+      HString str(strkey);
+      strkey = heap->string_table()->Lookup(str.value(),
+                                            str.length(),
+                                            str.hash());
+    }
+  }
+  if (strkey == NULL) return reinterpret_cast<char*>(heap->nil_slot());
+
   char* map = *reinterpret_cast<char**>(obj + 16);
-  char* space = map + 16;
-  uint32_t mask = *reinterpret_cast<uint64_t*>(obj + 8);
 
-  char* strkey = RuntimeToString(heap, stack_top, key);
+  // Small objects are scanned linearly, keys are placed one after another
+  if (map == NULL) {
+    char* space = obj + 24;
+    uint32_t index;
+    for (index = 0; index < HObject::kInlineProperties << 4; index += 16) {
+      char* entry_key = *reinterpret_cast<char**>(space + index);
+      if (entry_key == strkey) return space + index + 8;
+      if (entry_key == NULL) break;
+    }
+    if (!insert) return reinterpret_cast<char*>(heap->nil_slot());
 
-  // Compute hash lazily
-  uint32_t* hash_addr = reinterpret_cast<uint32_t*>(strkey + 8);
-  uint32_t hash = *hash_addr;
-  if (hash == 0) {
-    hash = ComputeHash(strkey + 24, *reinterpret_cast<uint32_t*>(strkey + 16));
-    *hash_addr = hash;
-  }
+    if (index < HObject::kInlineProperties << 4) {
+      *reinterpret_cast<char**>(space + index) = strkey;
+      return space + index + 8;
+    }
 
-  // Dive into space and walk it in circular manner
-  uint32_t start = hash & mask;
-  uint32_t end = start == 0 ? mask : start - 8;
+    // Object has outgrown inline entries - move them to map
+    RuntimeGrowObject(heap, stack_top, obj);
+    map = *reinterpret_cast<char**>(obj + 16);
+  }
 
-  uint32_t index = start;
-  char* key_slot = NULL;
-  while (index != end) {
-    key_slot = *reinterpret_cast<char**>(space + index);
-    if (key_slot == NULL) break;
-    if (RuntimeCompare(key_slot, strkey) == 0) break;
+  uint32_t mask = *reinterpret_cast<uint64_t*>(obj + 8);
+  uint32_t hash = *reinterpret_cast<uint32_t*>(strkey + 8);
 
-    index += 8;
-    if (index > mask) index = 0;
-  }
+  // Maps are never filled more than by half, so probing always
+  // ends at an empty entry
+  char* entry = FindEntry(map + 16, mask, hash, strkey);
+  if (*reinterpret_cast<char**>(entry) == strkey) return entry + 8;
+  if (!insert) return reinterpret_cast<char*>(heap->nil_slot());
 
-  // All key slots are filled - rehash and lookup again
-  if (index == end) {
-    assert(insert);
+  uint32_t size = *reinterpret_cast<uint32_t*>(map + 8);
+  uint32_t count = *reinterpret_cast<uint32_t*>(map + 12);
+  if ((count + 1) << 1 > size) {
     RuntimeGrowObject(heap, stack_top, obj);
-    return RuntimeLookupProperty(heap, stack_top, obj, strkey, insert);
-  }
 
-  if (insert) {
-    *reinterpret_cast<char**>(space + index) = strkey;
+    map = *reinterpret_cast<char**>(obj + 16);
+    mask = *reinterpret_cast<uint64_t*>(obj + 8);
+    entry = FindEntry(map + 16, mask, hash, strkey);
   }
 
-  return space + index + (mask + 8);
+  *reinterpret_cast<char**>(entry) = strkey;
+  *reinterpret_cast<uint32_t*>(map + 12) += 1;
+
+  return entry + 8;
 }
 
 
 char* RuntimeGrowObject(Heap* heap, char* stack_top, char* obj) {
   char** map_addr = reinterpret_cast<char**>(obj + 16);
   char* map = *map_addr;
-  uint32_t size = *reinterpret_cast<uint32_t*>(map + 8);
+  char* space;
+  uint32_t size;
+  uint32_t count;
+  uint32_t new_size;
+
+  if (map == NULL) {
+    // Inline entries are all taken, map will be filled only by half
+    // after next insertion
+    space = obj + 24;
+    size = HObject::kInlineProperties;
+    count = HObject::kInlineProperties;
+    new_size = PowerOfTwo((count + 1) << 1);
+  } else {
+    space = map + 16;
+    size = *reinterpret_cast<uint32_t*>(map + 8);
+    count = *reinterpret_cast<uint32_t*>(map + 12);
+    new_size = size << 1;
+  }
 
+  // NOTE: GC should not run here, because `obj` may be moved
   char* new_map = heap->AllocateTagged(Heap::kTagMap,
-                                       8 + (size << 5),
-                                       stack_top);
-  // Set map size
-  *(uint32_t*)(new_map + 8) = size << 1;
+                                       8 + (new_size << 4),
+                                       NULL);
+  // Set map size and count of keys
+  *reinterpret_cast<uint32_t*>(new_map + 8) = new_size;
+  *reinterpret_cast<uint32_t*>(new_map + 12) = count;
 
   // Fill new map with zeroes
-  memset(new_map + 16, 0, size << 5);
-
-  // Replace old map with a new
-  *map_addr = new_map;
+  memset(new_map + 16, 0, new_size << 4);
 
   // Change mask
-  uint32_t mask = (size << 4) - 8;
-  *reinterpret_cast<uint32_t*>(obj + 8) = mask;
-
-  char* space = map + 16;
-
-  // And rehash properties to new map
-  for (uint32_t index = 0; index < size << 3; index += 8) {
-    char* key= *reinterpret_cast<char**>(space + index);
-    if (key== NULL) continue;
-
-    char* value = *reinterpret_cast<char**>(space + index + (size << 3));
-    assert(value != NULL);
-
-    char* slot = RuntimeLookupProperty(heap, stack_top, obj, key, true);
-    *reinterpret_cast<char**>(slot) = value;
+  uint32_t mask = (new_size - 1) << 4;
+  *reinterpret_cast<uint64_t*>(obj + 8) = mask;
+
+  // And move entries to a new map (keys are unique, so there's no need
+  // to compare them)
+  char* new_space = new_map + 16;
+  for (uint32_t index = 0; index < size << 4; index += 16) {
+    char* key = *reinterpret_cast<char**>(space + index);
+    if (key == NULL) continue;
+
+    uint32_t hash = *reinterpret_cast<uint32_t*>(key + 8);
+    char* entry = FindEntry(new_space, mask, hash, NULL);
+    *reinterpret_cast<char**>(entry) = key;
+    *reinterpret_cast<char**>(entry + 8) = *reinterpret_cast<char**>(
+        space + index + 8);
   }
 
+  // Replace old map with a new
+  *map_addr = new_map;
+
   return 0;
 }
 
@@ -132,18 +289,15 @@ char* RuntimeToString(Heap* heap, char* stack_top, char* value) {
     }
    case Heap::kTagNumber:
     {
-      char str[128];
-      uint32_t len;
-
+      // Numbers that were used as property keys are already interned
       if (HValue::IsUnboxed(value)) {
-        int64_t num = HNumber::Untag(reinterpret_cast<int64_t>(value));
-        // Maximum int64 value may contain only 20 chars, last one for '\0'
-        len = snprintf(str, sizeof(str), "%lld", num);
-      } else {
-        double num = *reinterpret_cast<double*>(value + 8);
-        len = snprintf(str, sizeof(str), "%g", num);
+        char* cached = heap->GetNumberString(value);
+        if (cached != NULL) return cached;
       }
 
+      char str[128];
+      uint32_t len = NumberToString(value, str, sizeof(str));
+
       // And create new string
       return HString::New(heap, stack_top, str, len);
     }
@@ -203,10 +357,12 @@ char* RuntimeToBoolean(Heap* heap, char* stack_top, char* value) {
    case Heap::kTagNil:
     return HBoolean::New(heap, stack_top, false);
    case Heap::kTagNumber:
-    {
-      // TODO: Handle boxed numbers here too
+    if (HValue::IsUnboxed(value)) {
       int64_t num = HNumber::Untag(reinterpret_cast<int64_t>(value));
       return HBoolean::New(heap, stack_top, num != 0);
+    } else {
+      double num = *reinterpret_cast<double*>(value + 8);
+      return HBoolean::New(heap, stack_top, num != 0);
     }
    default:
     assert(0 && "Unexpected");
@@ -232,6 +388,96 @@ size_t RuntimeCompare(char* lhs, char* rhs) {
 }
 
 
+// Numeric value of any value, comparison can't allocate so
+// strings are parsed in place. Objects, functions and strings that aren't
+// numbers are NaN
+static double ValueToDouble(char* value) {
+  switch (HValue::GetTag(value)) {
+   case Heap::kTagNil:
+    return 0;
+   case Heap::kTagNumber:
+    if (HValue::IsUnboxed(value)) {
+      return HNumber::Untag(reinterpret_cast<int64_t>(value));
+    }
+    return *reinterpret_cast<double*>(value + 8);
+   case Heap::kTagBoolean:
+    return *reinterpret_cast<int8_t*>(value + 8) == 1 ? 1 : 0;
+   case Heap::kTagString:
+    {
+      char* str = value + 24;
+      uint32_t length = *reinterpret_cast<uint32_t*>(value + 16);
+
+      if (!StringIsNumber(str, length)) return NAN;
+      if (StringIsDouble(str, length)) return StringToDouble(str, length);
+      return StringToInt(str, length);
+    }
+   default:
+    return NAN;
+  }
+}
+
+
+// Lexicographical order of strings
+static int CompareStrings(char* lhs, char* rhs) {
+  uint32_t lhs_length = *reinterpret_cast<uint32_t*>(lhs + 16);
+  uint32_t rhs_length = *reinterpret_cast<uint32_t*>(rhs + 16);
+
+  int result = memcmp(lhs + 24,
+                      rhs + 24,
+                      lhs_length < rhs_length ? lhs_length : rhs_length);
+  if (result != 0) return result;
+
+  return lhs_length < rhs_length ? -1 : lhs_length > rhs_length ? 1 : 0;
+}
+
+
+static bool StrictEquals(char* lhs, char* rhs) {
+  Heap::HeapTag lhs_tag = HValue::GetTag(lhs);
+  if (lhs_tag != HValue::GetTag(rhs)) return false;
+
+  switch (lhs_tag) {
+   case Heap::kTagNumber:
+    // NaN isn't equal to itself, so never compare numbers by address
+    return ValueToDouble(lhs) == ValueToDouble(rhs);
+   case Heap::kTagString:
+    return lhs == rhs || CompareStrings(lhs, rhs) == 0;
+   default:
+    return lhs == rhs;
+  }
+}
+
+
+static bool LooseEquals(char* lhs, char* rhs) {
+  Heap::HeapTag lhs_tag = HValue::GetTag(lhs);
+  Heap::HeapTag rhs_tag = HValue::GetTag(rhs);
+  if (lhs_tag == rhs_tag) return StrictEquals(lhs, rhs);
+
+  // nil, objects and functions are equal only to themselves
+  if (lhs_tag == Heap::kTagNil || rhs_tag == Heap::kTagNil ||
+      lhs_tag == Heap::kTagObject || rhs_tag == Heap::kTagObject ||
+      lhs_tag == Heap::kTagFunction || rhs_tag == Heap::kTagFunction) {
+    return false;
+  }
+
+  return ValueToDouble(lhs) == ValueToDouble(rhs);
+}
+
+
+// Returns true if `lhs` < `rhs` (or `lhs` <= `rhs` if `or_equal` is true),
+// unordered values (i.e. NaN) are neither less nor greater
+static bool Less(char* lhs, char* rhs, bool or_equal) {
+  if (HValue::GetTag(lhs) == Heap::kTagString &&
+      HValue::GetTag(rhs) == Heap::kTagString) {
+    int result = CompareStrings(lhs, rhs);
+    return or_equal ? result <= 0 : result < 0;
+  }
+
+  double lnum = ValueToDouble(lhs);
+  double rnum = ValueToDouble(rhs);
+  return or_equal ? lnum <= rnum : lnum < rnum;
+}
+
+
 char* RuntimeCoerceType(Heap* heap,
                         char* stack_top,
                         char* required,
@@ -241,36 +487,173 @@ char* RuntimeCoerceType(Heap* heap,
 }
 
 
-char* RuntimeBinOpAdd(Heap* heap, char* stack_top, char* lhs, char* rhs) {
-  // nil + nil = 0
-  if (lhs == NULL && rhs == NULL) {
-    return HNumber::New(heap, stack_top, static_cast<uint64_t>(0));
+// Unboxed number if `value` is integral and fits into it, heap number otherwise
+static char* NumberFromDouble(Heap* heap, char* stack_top, double value) {
+  // Unboxed numbers are 63bit, -0 can't be represented as unboxed
+  if (value > -4611686018427387904.0 && value < 4611686018427387904.0 &&
+      value == floor(value) && (value != 0 || !signbit(value))) {
+    return HNumber::New(heap,
+                        stack_top,
+                        static_cast<uint64_t>(static_cast<int64_t>(value)));
   }
 
-  // nil + any = any, any + nil = any
-  if (lhs == NULL) return rhs;
-  if (rhs == NULL) return lhs;
+  return HNumber::New(heap, stack_top, value);
+}
 
-  // So we surely now that both lhs and rhs are not nils here
+
+// ECMAScript's ToInt32: truncation modulo 2^32
+static int32_t ValueToInt32(char* value) {
+  double num = ValueToDouble(value);
+  if (isnan(num) || isinf(num)) return 0;
+
+  num = fmod(trunc(num), 4294967296.0);
+  if (num < 0) num += 4294967296.0;
+
+  return static_cast<int32_t>(static_cast<uint32_t>(num));
+}
+
+
+static inline char* Int32ToNumber(Heap* heap, char* stack_top, int64_t value) {
+  return HNumber::New(heap, stack_top, static_cast<uint64_t>(value));
+}
+
+
+char* RuntimeBinOpAdd(Heap* heap, char* stack_top, char* lhs, char* rhs) {
   Heap::HeapTag lhs_tag = HValue::GetTag(lhs);
-  char* coerced_rhs = RuntimeCoerceType(heap, stack_top, lhs, rhs);
+  Heap::HeapTag rhs_tag = HValue::GetTag(rhs);
 
-  // Just to shut up compiler
-  coerced_rhs = coerced_rhs;
+  if (lhs_tag == Heap::kTagString || rhs_tag == Heap::kTagString) {
+    // nil + any = any, any + nil = any
+    if (lhs_tag == Heap::kTagNil) return rhs;
+    if (rhs_tag == Heap::kTagNil) return lhs;
 
-  switch (lhs_tag) {
-    case Heap::kTagString:
-     // TODO: Concatenate strings
-    case Heap::kTagNumber:
-     // TODO: Unbox and add
-     return NULL;
-    case Heap::kTagObject:
-     // object + object = nil
-     return NULL;
-    default:
-     assert(0 && "Unexpected");
-     return NULL;
+    // TODO: Concatenate strings
+    return NULL;
   }
+
+  // object + object = nil
+  if (lhs_tag == Heap::kTagObject || rhs_tag == Heap::kTagObject) {
+    return NULL;
+  }
+
+  // Never return operands as is: they may be reused intermediate boxes
+  return NumberFromDouble(heap,
+                          stack_top,
+                          ValueToDouble(lhs) + ValueToDouble(rhs));
+}
+
+
+char* RuntimeBinOpSub(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return NumberFromDouble(heap,
+                          stack_top,
+                          ValueToDouble(lhs) - ValueToDouble(rhs));
+}
+
+
+char* RuntimeBinOpMul(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return NumberFromDouble(heap,
+                          stack_top,
+                          ValueToDouble(lhs) * ValueToDouble(rhs));
+}
+
+
+char* RuntimeBinOpDiv(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return NumberFromDouble(heap,
+                          stack_top,
+                          ValueToDouble(lhs) / ValueToDouble(rhs));
+}
+
+
+char* RuntimeBinOpMod(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return NumberFromDouble(heap,
+                          stack_top,
+                          fmod(ValueToDouble(lhs), ValueToDouble(rhs)));
+}
+
+
+char* RuntimeBinOpBAnd(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return Int32ToNumber(heap, stack_top, ValueToInt32(lhs) & ValueToInt32(rhs));
+}
+
+
+char* RuntimeBinOpBOr(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return Int32ToNumber(heap, stack_top, ValueToInt32(lhs) | ValueToInt32(rhs));
+}
+
+
+char* RuntimeBinOpBXor(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return Int32ToNumber(heap, stack_top, ValueToInt32(lhs) ^ ValueToInt32(rhs));
+}
+
+
+char* RuntimeBinOpShl(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  uint32_t value = static_cast<uint32_t>(ValueToInt32(lhs));
+  uint32_t shift = static_cast<uint32_t>(ValueToInt32(rhs)) & 0x1f;
+
+  return Int32ToNumber(heap,
+                       stack_top,
+                       static_cast<int32_t>(value << shift));
+}
+
+
+char* RuntimeBinOpShr(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  uint32_t shift = static_cast<uint32_t>(ValueToInt32(rhs)) & 0x1f;
+
+  return Int32ToNumber(heap, stack_top, ValueToInt32(lhs) >> shift);
+}
+
+
+char* RuntimeBinOpUShr(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  uint32_t value = static_cast<uint32_t>(ValueToInt32(lhs));
+  uint32_t shift = static_cast<uint32_t>(ValueToInt32(rhs)) & 0x1f;
+
+  return Int32ToNumber(heap, stack_top, value >> shift);
+}
+
+
+char* RuntimeBinOpLt(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, Less(lhs, rhs, false));
+}
+
+
+char* RuntimeBinOpGt(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, Less(rhs, lhs, false));
+}
+
+
+char* RuntimeBinOpLe(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, Less(lhs, rhs, true));
+}
+
+
+char* RuntimeBinOpGe(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, Less(rhs, lhs, true));
+}
+
+
+char* RuntimeBinOpEq(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, LooseEquals(lhs, rhs));
+}
+
+
+char* RuntimeBinOpStrictEq(Heap* heap,
+                           char* stack_top,
+                           char* lhs,
+                           char* rhs) {
+  return HBoolean::New(heap, stack_top, StrictEquals(lhs, rhs));
+}
+
+
+char* RuntimeBinOpNe(Heap* heap, char* stack_top, char* lhs, char* rhs) {
+  return HBoolean::New(heap, stack_top, !LooseEquals(lhs, rhs));
+}
+
+
+char* RuntimeBinOpStrictNe(Heap* heap,
+                           char* stack_top,
+                           char* lhs,
+                           char* rhs) {
+  return HBoolean::New(heap, stack_top, !StrictEquals(lhs, rhs));
 }
 
 } // namespace candor
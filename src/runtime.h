@@ -8,6 +8,8 @@ namespace candor {
 
 // Forward declarations
 class Heap;
+class FeedbackVector;
+class AstNode;
 
 // Wrapper for heap()->new_space()->Allocate()
 typedef char* (*RuntimeAllocateCallback)(Heap* heap,
@@ -18,6 +20,20 @@ char* RuntimeAllocate(Heap* heap, uint32_t bytes, char* stack_top);
 typedef void (*RuntimeCollectGarbageCallback)(Heap* heap, char* stack_top);
 void RuntimeCollectGarbage(Heap* heap, char* stack_top);
 
+// Compiles hot function with optimizing compiler,
+// returns address of optimized code or NULL if function can't be optimized
+typedef char* (*RuntimeOptimizeCallback)(Heap* heap, FeedbackVector* vector);
+char* RuntimeOptimize(Heap* heap, FeedbackVector* vector);
+
+typedef char* (*RuntimeOsrCallback)(Heap* heap,
+                                    FeedbackVector* vector,
+                                    AstNode* loop);
+char* RuntimeOsr(Heap* heap, FeedbackVector* vector, AstNode* loop);
+
+// Invalidates optimized code of function whose speculation has failed
+typedef void (*RuntimeDeoptimizeCallback)(Heap* heap, FeedbackVector* vector);
+void RuntimeDeoptimize(Heap* heap, FeedbackVector* vector);
+
 // Performs lookup into a hashmap
 // if insert=1 - inserts key into map space
 typedef char* (*RuntimeLookupPropertyCallback)(Heap* heap,
@@ -58,7 +74,37 @@ typedef char* (*RuntimeBinOpCallback)(Heap* heap,
                                       char* stack_top,
                                       char* lhs,
                                       char* rhs);
+
+// Arithmetic binops, operands are coerced to numbers
 char* RuntimeBinOpAdd(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpSub(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpMul(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpDiv(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpMod(Heap* heap, char* stack_top, char* lhs, char* rhs);
+
+// Bitwise binops, operands are truncated to int32
+char* RuntimeBinOpBAnd(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpBOr(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpBXor(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpShl(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpShr(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpUShr(Heap* heap, char* stack_top, char* lhs, char* rhs);
+
+// Comparison binops, never allocate and return boolean
+char* RuntimeBinOpLt(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpGt(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpLe(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpGe(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpEq(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpStrictEq(Heap* heap,
+                           char* stack_top,
+                           char* lhs,
+                           char* rhs);
+char* RuntimeBinOpNe(Heap* heap, char* stack_top, char* lhs, char* rhs);
+char* RuntimeBinOpStrictNe(Heap* heap,
+                           char* stack_top,
+                           char* lhs,
+                           char* rhs);
 
 } // namespace candor
 
@@ -128,7 +128,8 @@ void ScopeSlot::Enumerate(void* scope, ScopeSlot* slot) {
   if (slot->is_stack()) {
     slot->index(scope_->stack_index_++);
   } else if (slot->is_context()) {
-    if (slot->depth() <= 0) {
+    // Globals are indexed by Scope::Analyze
+    if (slot->depth() == 0) {
       List<ScopeSlot*, ZoneObject>::Item* item = slot->uses()->head();
 
       // Find if we've already indexed some of uses
@@ -154,8 +155,276 @@ void ScopeSlot::Enumerate(void* scope, ScopeSlot* slot) {
 }
 
 
+// Returns true if expression reads `slot`
+static bool UsesSlot(AstNode* node, ScopeSlot* slot) {
+  if (node->is(AstNode::kValue)) return AstValue::Cast(node)->slot() == slot;
+
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    if (UsesSlot(item->value(), slot)) return true;
+  }
+
+  return false;
+}
+
+
+// Marks slots that may have mutable double box (see ScopeSlot).
+// Value of assignment expression is the box itself, so slots assigned
+// inside of expressions (or by `++`/`--`) can't have it, neither can
+// arguments as their heap numbers are owned by caller
+static void AnalyzeBoxes(AstNode* node, bool statement) {
+  AstList::Item* item;
+
+  switch (node->type()) {
+   case AstNode::kFunction:
+    item = FunctionLiteral::Cast(node)->args()->head();
+    for (; item != NULL; item = item->next()) {
+      if (!item->value()->is(AstNode::kValue)) continue;
+      AstValue::Cast(item->value())->slot()->no_box(true);
+    }
+    // Fall through
+   case AstNode::kBlock:
+    statement = true;
+    break;
+   case AstNode::kCall:
+    {
+      FunctionLiteral* fn = FunctionLiteral::Cast(node);
+      AnalyzeBoxes(fn->variable(), false);
+
+      item = fn->args()->head();
+      for (; item != NULL; item = item->next()) {
+        AnalyzeBoxes(item->value(), false);
+      }
+    }
+    break;
+   case AstNode::kAssign:
+    if (node->lhs()->is(AstNode::kValue)) {
+      ScopeSlot* slot = AstValue::Cast(node->lhs())->slot();
+
+      if (!statement) {
+        slot->no_box(true);
+      } else if (node->rhs()->is(AstNode::kBinOp) &&
+                 BinOp::Cast(node->rhs())->is_math() &&
+                 UsesSlot(node->rhs(), slot)) {
+        slot->accumulator(true);
+      }
+    }
+    statement = false;
+    break;
+   case AstNode::kUnOp:
+    if (UnOp::Cast(node)->is_changing() &&
+        node->lhs()->is(AstNode::kValue)) {
+      AstValue::Cast(node->lhs())->slot()->no_box(true);
+    }
+    statement = false;
+    break;
+   default:
+    statement = false;
+    break;
+  }
+
+  item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    AnalyzeBoxes(item->value(), statement);
+  }
+}
+
+
+// Context slots' depth is a number of functions between use and
+// definition, but only functions with context slots allocate contexts.
+// `fns` holds functions enclosing `node`, innermost first
+static void AdjustDepths(AstNode* node, AstList* fns) {
+  if (node->is(AstNode::kValue)) {
+    AstValue* value = AstValue::Cast(node);
+    if (!value->is_slot()) return;
+
+    ScopeSlot* slot = value->slot();
+    if (!slot->is_context() ||
+        slot->depth() <= 0 ||
+        slot->is_depth_adjusted()) {
+      return;
+    }
+
+    int32_t depth = 0;
+    AstList::Item* item = fns->head();
+    for (int32_t i = 0; i < slot->depth(); i++, item = item->next()) {
+      assert(item != NULL);
+      if (item->value()->context_slots() != 0) depth++;
+    }
+    slot->adjust_depth(depth);
+    return;
+  }
+
+  AstList::Item* item;
+  if (node->is(AstNode::kFunction) || node->is(AstNode::kCall)) {
+    FunctionLiteral* fn = FunctionLiteral::Cast(node);
+
+    // Function's name belongs to outer scope
+    if (fn->variable() != NULL) AdjustDepths(fn->variable(), fns);
+
+    if (node->is(AstNode::kFunction) && !node->is_root()) fns->Unshift(node);
+
+    item = fn->args()->head();
+    for (; item != NULL; item = item->next()) {
+      AdjustDepths(item->value(), fns);
+    }
+  }
+
+  item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    AdjustDepths(item->value(), fns);
+  }
+
+  if (node->is(AstNode::kFunction) && !node->is_root()) fns->Shift();
+}
+
+
+// Collects variables of contexts that `node` looks up (through at least
+// two parents) in function's own code, uses in loops are counted twice
+static void CollectContextUses(AstNode* node,
+                               List<ScopeSlot*, EmptyClass>* uses,
+                               bool in_loop) {
+  if (node->is(AstNode::kValue)) {
+    AstValue* value = AstValue::Cast(node);
+    if (!value->is_slot() ||
+        !value->slot()->is_context() ||
+        value->slot()->depth() < 2) {
+      return;
+    }
+
+    uses->Push(value->slot());
+    if (in_loop) uses->Push(value->slot());
+    return;
+  }
+
+  AstList::Item* item;
+  if (node->is(AstNode::kFunction) || node->is(AstNode::kCall)) {
+    FunctionLiteral* fn = FunctionLiteral::Cast(node);
+
+    // Function's name belongs to outer scope
+    if (fn->variable() != NULL) {
+      CollectContextUses(fn->variable(), uses, in_loop);
+    }
+
+    // Nested function has a display of it's own
+    if (node->is(AstNode::kFunction)) return;
+
+    item = fn->args()->head();
+    for (; item != NULL; item = item->next()) {
+      CollectContextUses(item->value(), uses, in_loop);
+    }
+  }
+
+  in_loop = in_loop || node->is(AstNode::kWhile);
+  item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    CollectContextUses(item->value(), uses, in_loop);
+  }
+}
+
+
+// Each lookup of context at depth N is N dependent loads, contexts that
+// function looks up repeatedly are loaded once at entry instead
+static void AllocateDisplay(AstNode* node) {
+  AstList::Item* item;
+  if (node->is(AstNode::kFunction)) {
+    FunctionLiteral* fn = FunctionLiteral::Cast(node);
+    List<ScopeSlot*, EmptyClass> uses;
+    int32_t max = 0;
+
+    item = fn->children()->head();
+    for (; item != NULL; item = item->next()) {
+      CollectContextUses(item->value(), &uses, false);
+    }
+
+    List<ScopeSlot*, EmptyClass>::Item* use = uses.head();
+    for (; use != NULL; use = use->next()) {
+      if (use->value()->depth() > max) max = use->value()->depth();
+    }
+
+    for (int32_t depth = 2; depth <= max; depth++) {
+      ScopeSlot* first = NULL;
+      int32_t count = 0;
+      for (use = uses.head(); use != NULL; use = use->next()) {
+        if (use->value()->depth() != depth) continue;
+        if (first == NULL) first = use->value();
+        count++;
+      }
+      if (count > 1) fn->AddDisplay(first);
+    }
+  }
+
+  // Arguments of call may be functions too
+  if (node->is(AstNode::kCall)) {
+    item = FunctionLiteral::Cast(node)->args()->head();
+    for (; item != NULL; item = item->next()) {
+      AllocateDisplay(item->value());
+    }
+  }
+
+  item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    AllocateDisplay(item->value());
+  }
+}
+
+
+// Global variables live in root context, every name gets a cell there,
+// so code loads and stores them directly instead of looking up property
+// of global object
+static void AllocateGlobals(AstNode* node,
+                            HashMap<ScopeSlot*, ZoneObject>* cells,
+                            int32_t* count) {
+  if (node->is(AstNode::kValue)) {
+    AstValue* value = AstValue::Cast(node);
+    if (!value->is_slot() ||
+        !value->slot()->is_context() ||
+        value->slot()->depth() != -1) {
+      return;
+    }
+
+    AstNode* name = value->name();
+    ScopeSlot* cell = cells->Get(name->value(), name->length());
+    if (cell == NULL) {
+      cell = value->slot();
+      cell->index((*count)++);
+      cells->Set(name->value(), name->length(), cell);
+    }
+    value->slot()->index(cell->index());
+    return;
+  }
+
+  AstList::Item* item;
+  if (node->is(AstNode::kFunction) || node->is(AstNode::kCall)) {
+    FunctionLiteral* fn = FunctionLiteral::Cast(node);
+
+    if (fn->variable() != NULL) AllocateGlobals(fn->variable(), cells, count);
+
+    item = fn->args()->head();
+    for (; item != NULL; item = item->next()) {
+      AllocateGlobals(item->value(), cells, count);
+    }
+  }
+
+  item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    AllocateGlobals(item->value(), cells, count);
+  }
+}
+
+
 void Scope::Analyze(AstNode* ast) {
   ScopeAnalyze a(ast);
+  AnalyzeBoxes(ast, true);
+
+  AstList fns;
+  AdjustDepths(ast, &fns);
+  AllocateDisplay(ast);
+
+  HashMap<ScopeSlot*, ZoneObject> cells;
+  int32_t count = 0;
+  AllocateGlobals(ast, &cells, &count);
+  FunctionLiteral::Cast(ast)->global_slots(count);
 }
 
 
@@ -23,12 +23,20 @@ class ScopeSlot : public ZoneObject {
     kContext
   };
 
-  ScopeSlot(Type type) : type_(type), index_(-1), depth_(0) {
+  ScopeSlot(Type type) : type_(type),
+                         index_(-1),
+                         depth_(0),
+                         depth_adjusted_(false),
+                         accumulator_(false),
+                         no_box_(false) {
   }
 
   ScopeSlot(Type type, uint32_t depth) : type_(type),
                                          index_(-1),
-                                         depth_(depth) {
+                                         depth_(depth),
+                                         depth_adjusted_(false),
+                                         accumulator_(false),
+                                         no_box_(false) {
   }
 
   static void Enumerate(void* scope, ScopeSlot* slot);
@@ -38,13 +46,36 @@ class ScopeSlot : public ZoneObject {
 
   inline int32_t index() { return index_; }
   inline void index(int32_t index) { index_ = index; }
+
+  // Number of contexts between use and definition, -1 for global variables,
+  // which are cells in root context (see Scope::Analyze)
   inline int32_t depth() { return depth_; }
 
+  // Functions without context slots don't allocate contexts, so they're
+  // skipped by lookup (see Scope::Analyze)
+  inline bool is_depth_adjusted() { return depth_adjusted_; }
+  inline void adjust_depth(int32_t depth) {
+    depth_ = depth;
+    depth_adjusted_ = true;
+  }
+
   inline List<ScopeSlot*, ZoneObject>* uses() { return &uses_; }
 
+  // Stack slot that accumulates numbers (`a = a + b`) and is assigned only
+  // by statements, may keep it's heap number and update it in place
+  inline bool has_mutable_box() {
+    return is_stack() && accumulator_ && !no_box_;
+  }
+  inline void accumulator(bool value) { accumulator_ = value; }
+  inline void no_box(bool value) { no_box_ = value; }
+
   Type type_;
   int32_t index_;
   int32_t depth_;
+  bool depth_adjusted_;
+
+  bool accumulator_;
+  bool no_box_;
 
   List<ScopeSlot*, ZoneObject> uses_;
 };
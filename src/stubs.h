@@ -16,13 +16,31 @@ class RelocationInfo;
 
 #define STUBS_LIST(V)\
     V(Allocate)\
+    V(Optimize)\
+    V(Osr)\
+    V(Deoptimize)\
     V(Throw)\
     V(LookupProperty)\
     V(CoerceToBoolean)\
     V(BinaryAdd)\
     V(BinarySub)\
     V(BinaryMul)\
-    V(BinaryDiv)
+    V(BinaryDiv)\
+    V(BinaryMod)\
+    V(BinaryBAnd)\
+    V(BinaryBOr)\
+    V(BinaryBXor)\
+    V(BinaryShl)\
+    V(BinaryShr)\
+    V(BinaryUShr)\
+    V(BinaryLt)\
+    V(BinaryGt)\
+    V(BinaryLe)\
+    V(BinaryGe)\
+    V(BinaryEq)\
+    V(BinaryStrictEq)\
+    V(BinaryNe)\
+    V(BinaryStrictNe)
 
 class BaseStub : public FFunction {
  public:
@@ -75,7 +93,7 @@ class BinaryOpStub : public BaseStub {
     V##Stub* Get##V##Stub() {\
       if (stub_##V##_ == NULL) {\
         stub_##V##_ = new V##Stub(masm_);\
-        fullgen()->fns()->Push(stub_##V##_);\
+        fns()->Push(stub_##V##_);\
       }\
       return stub_##V##_;\
     }
@@ -89,13 +107,14 @@ class Stubs : public ZoneObject {
     STUBS_LIST(STUB_PROPERTY_INIT)
   }
 
-  inline Fullgen* fullgen() { return fullgen_; }
-  inline void fullgen(Fullgen* fullgen) { fullgen_ = fullgen; }
+  // Stubs are queued into `fns` on first use and generated with functions
+  inline List<FFunction*, ZoneObject>* fns() { return fns_; }
+  inline void fns(List<FFunction*, ZoneObject>* fns) { fns_ = fns; }
 
   STUBS_LIST(STUB_LAZY_ALLOCATOR)
  protected:
   Masm* masm_;
-  Fullgen* fullgen_;
+  List<FFunction*, ZoneObject>* fns_;
 
   STUBS_LIST(STUB_PROPERTY)
 };
@@ -6,22 +6,96 @@
 #include <stdint.h> // uint32_t
 #include <stdio.h> // vsnprintf
 #include <string.h> // strncmp, memset
-#include <unistd.h> // sysconf or getpagesize
+#include <unistd.h> // sysconf or getpagesize, read, close
+#include <fcntl.h> // open
+#include <sys/time.h> // gettimeofday
 
 namespace candor {
 
-inline uint32_t ComputeHash(const char* key, uint32_t length) {
-  uint32_t hash = 0;
-  for (uint32_t i = 0; i < length; i++) {
-    hash += key[i];
-    hash += (hash << 10);
-    hash ^= (hash >> 6);
+// Unaligned memory reads for hashing
+inline uint64_t ReadHashWord(const char* p) {
+  uint64_t result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+
+inline uint64_t ReadHashHalf(const char* p) {
+  uint32_t result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+
+// Multiply and fold 128-bit result
+inline uint64_t HashMix(uint64_t a, uint64_t b) {
+  __uint128_t r = a;
+  r *= b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+
+// wyhash-like function: consumes input by words (16 bytes per round),
+// `seed` should be random to make hash-flooding attacks impractical
+inline uint32_t ComputeHash(const char* key, uint32_t length, uint64_t seed) {
+  static const uint64_t p0 = 0xa0761d6478bd642fULL;
+  static const uint64_t p1 = 0xe7037ed1a0b428dbULL;
+  static const uint64_t p2 = 0x8ebc6af09c88c6e3ULL;
+
+  uint64_t a;
+  uint64_t b;
+
+  seed ^= p0;
+  if (length <= 16) {
+    if (length >= 4) {
+      uint32_t shift = (length >> 3) << 2;
+      a = (ReadHashHalf(key) << 32) | ReadHashHalf(key + shift);
+      b = (ReadHashHalf(key + length - 4) << 32) |
+          ReadHashHalf(key + length - 4 - shift);
+    } else if (length > 0) {
+      a = (static_cast<uint64_t>(static_cast<uint8_t>(key[0])) << 16) |
+          (static_cast<uint64_t>(static_cast<uint8_t>(key[length >> 1])) << 8) |
+          static_cast<uint8_t>(key[length - 1]);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    uint32_t left = length;
+    while (left > 16) {
+      seed = HashMix(ReadHashWord(key) ^ p1, ReadHashWord(key + 8) ^ seed);
+      key += 16;
+      left -= 16;
+    }
+    a = ReadHashWord(key + left - 16);
+    b = ReadHashWord(key + left - 8);
   }
-  hash += (hash << 3);
-  hash ^= (hash >> 11);
-  hash += (hash << 15);
 
-  return hash;
+  uint64_t hash = HashMix(p1 ^ length, HashMix(a ^ p1, b ^ seed) ^ p2);
+
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+
+// Returns random value (used for hash seeds)
+inline uint64_t GetRandomSeed() {
+  uint64_t result = 0;
+
+  int fd = open("/dev/urandom", O_RDONLY);
+  if (fd != -1) {
+    if (read(fd, &result, sizeof(result)) != sizeof(result)) result = 0;
+    close(fd);
+  }
+
+  // Fallback to time and address of stack variable
+  if (result == 0) {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    result = HashMix(tv.tv_sec ^ reinterpret_cast<uint64_t>(&tv),
+                     tv.tv_usec ^ 0xe7037ed1a0b428dbULL);
+  }
+
+  return result;
 }
 
 
@@ -80,6 +154,11 @@ class List {
     Item* next = new Item(item);
     next->prev_ = NULL;
     next->next_ = head_;
+    if (head_ == NULL) {
+      current_ = next;
+    } else {
+      head_->prev_ = next;
+    }
     head_ = next;
     length_++;
   }
@@ -102,7 +181,43 @@ class List {
   }
 
 
+  // Unlinks item from list and deletes it
+  void Remove(Item* item) {
+    if (item->prev_ == NULL) {
+      head_ = item->next_;
+    } else {
+      item->prev_->next_ = item->next_;
+    }
+    if (item->next_ == NULL) {
+      current_ = item->prev_;
+    } else {
+      item->next_->prev_ = item->prev_;
+    }
+
+    delete item;
+    length_--;
+  }
+
+
+  // Inserts value before `next` item (or at the end if `next` is NULL)
+  void InsertBefore(Item* next, T value) {
+    if (next == NULL) return Push(value);
+
+    Item* item = new Item(value);
+    item->prev_ = next->prev_;
+    item->next_ = next;
+    if (next->prev_ == NULL) {
+      head_ = item;
+    } else {
+      next->prev_->next_ = item;
+    }
+    next->prev_ = item;
+    length_++;
+  }
+
+
   inline Item* head() { return head_; }
+  inline Item* tail() { return current_; }
   inline uint32_t length() { return length_; }
 
   bool allocated;
@@ -145,12 +260,16 @@ class HashMap {
   };
 
   HashMap() : head_(NULL), current_(NULL) {
+    // All maps are sharing the same per-process seed
+    static uint64_t seed = GetRandomSeed();
+    seed_ = seed;
+
     memset(&map_, 0, sizeof(map_));
   }
 
 
   void Set(const char* key, uint32_t length, T value) {
-    uint32_t index = ComputeHash(key, length) & mask_;
+    uint32_t index = ComputeHash(key, length, seed_) & mask_;
     Item* i = map_[index];
     Item* next = new Item(key, length, value);
 
@@ -173,7 +292,7 @@ class HashMap {
 
 
   T Get(const char* key, uint32_t length) {
-    uint32_t index = ComputeHash(key, length) & mask_;
+    uint32_t index = ComputeHash(key, length, seed_) & mask_;
     Item* i = map_[index];
 
     while (i != NULL) {
@@ -203,6 +322,7 @@ class HashMap {
   Item* map_[size_];
   Item* head_;
   Item* current_;
+  uint64_t seed_;
 };
 
 
@@ -240,7 +360,7 @@ class PrintBuffer {
 
   void Finalize() {
     if (ended()) return;
-    buffer_[total_] = 0;
+    buffer_[0] = 0;
   }
 
   inline bool ended() { return left_ <= 0; }
@@ -271,6 +391,23 @@ inline uint32_t PowerOfTwo(uint32_t value) {
 }
 
 
+// True if the whole string is a decimal number (digits with optional dot)
+inline bool StringIsNumber(const char* value, uint32_t length) {
+  bool has_digits = false;
+  bool has_dot = false;
+  for (uint32_t index = 0; index < length; index++) {
+    if (value[index] == '.' && !has_dot) {
+      has_dot = true;
+      continue;
+    }
+    if (value[index] < '0' || value[index] > '9') return false;
+    has_digits = true;
+  }
+
+  return has_digits;
+}
+
+
 // Naive only for lexer generated number strings
 inline bool StringIsDouble(const char* value, uint32_t length) {
   for (uint32_t index = 0; index < length; index++) {
@@ -291,6 +428,26 @@ inline uint64_t StringToInt(const char* value, uint32_t length) {
 }
 
 
+// Writes decimal representation of value into buffer (should be at least
+// 21 bytes long), returns number of written chars
+inline uint32_t IntToString(int64_t value, char* buffer) {
+  char digits[24];
+  uint32_t count = 0;
+  uint64_t abs = value < 0 ? -static_cast<uint64_t>(value) : value;
+
+  do {
+    digits[count++] = '0' + abs % 10;
+    abs /= 10;
+  } while (abs != 0);
+
+  uint32_t length = 0;
+  if (value < 0) buffer[length++] = '-';
+  while (count > 0) buffer[length++] = digits[--count];
+
+  return length;
+}
+
+
 inline double StringToDouble(const char* value, uint32_t length) {
   double integral = 0;
   double floating = 0;
@@ -41,12 +41,13 @@ inline void Assembler::emit_rex_if_high(Register src) {
 
 
 inline void Assembler::emit_rexw(Register dst) {
-  emitb(0x48 | dst.high() << 2);
+  // Single register always goes into r/m field
+  emitb(0x48 | dst.high());
 }
 
 
 inline void Assembler::emit_rexw(Operand& dst) {
-  emitb(0x48 | dst.base().high() << 2);
+  emitb(0x48 | dst.base().high());
 }
 
 
@@ -85,9 +86,16 @@ inline void Assembler::emit_modrm(Register dst) {
 }
 
 
+inline void Assembler::emit_sib_if_needed(Operand& op) {
+  // rsp and r12 as a base can be encoded only with SIB byte
+  if (op.base().low() == 4) emitb(0x24);
+}
+
+
 inline void Assembler::emit_modrm(Operand &dst) {
   if (dst.scale() == Operand::one) {
     emitb(0x80 | dst.base().low());
+    emit_sib_if_needed(dst);
     emitl(dst.disp());
   } else {
     // TODO: Support scales
@@ -103,6 +111,7 @@ inline void Assembler::emit_modrm(Register dst, Register src) {
 inline void Assembler::emit_modrm(Register dst, Operand& src) {
   if (src.scale() == Operand::one) {
     emitb(0x80 | dst.low() << 3 | src.base().low());
+    emit_sib_if_needed(src);
     emitl(src.disp());
   } else {
   }
@@ -116,6 +125,7 @@ inline void Assembler::emit_modrm(Register dst, uint32_t op) {
 
 inline void Assembler::emit_modrm(Operand& dst, uint32_t op) {
   emitb(0x80 | op << 3 | dst.base().low());
+  emit_sib_if_needed(dst);
   emitl(dst.disp());
 }
 
@@ -137,6 +147,7 @@ inline void Assembler::emit_modrm(DoubleRegister dst, DoubleRegister src) {
 
 inline void Assembler::emit_modrm(DoubleRegister dst, Operand& src) {
   emitb(0x80 | dst.low() << 3 | src.base().low());
+  emit_sib_if_needed(src);
   emitl(src.disp());
 }
 
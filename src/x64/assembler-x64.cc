@@ -137,6 +137,14 @@ void Assembler::cmpb(Operand& dst, Immediate src) {
 }
 
 
+void Assembler::cmpl(Operand& dst, Immediate src) {
+  emit_rex_if_high(dst.base());
+  emitb(0x81);
+  emit_modrm(dst, 7);
+  emitl(src.value());
+}
+
+
 void Assembler::testb(Register dst, Immediate src) {
   emit_rexw(dst);
   emitb(0xF6);
@@ -145,6 +153,14 @@ void Assembler::testb(Register dst, Immediate src) {
 }
 
 
+void Assembler::testl(Operand& dst, Immediate src) {
+  emit_rex_if_high(dst.base());
+  emitb(0xF7);
+  emit_modrm(dst, 0);
+  emitl(src.value());
+}
+
+
 void Assembler::jmp(Label* label) {
   emitb(0xE9);
   emitl(0x12345678);
@@ -152,6 +168,13 @@ void Assembler::jmp(Label* label) {
 }
 
 
+void Assembler::jmp(Register dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 4);
+}
+
+
 void Assembler::jmp(Condition cond, Label* label) {
   emitb(0x0F);
   switch (cond) {
@@ -179,6 +202,24 @@ void Assembler::jmp(Condition cond, Label* label) {
    case kOverflow:
     emitb(0x80);
     break;
+   case kNoOverflow:
+    emitb(0x81);
+    break;
+   case kBelow:
+    emitb(0x82);
+    break;
+   case kBelowEq:
+    emitb(0x86);
+    break;
+   case kAbove:
+    emitb(0x87);
+    break;
+   case kAboveEq:
+    emitb(0x83);
+    break;
+   case kParity:
+    emitb(0x8A);
+    break;
    default:
     assert(0 && "unexpected");
   }
@@ -223,13 +264,40 @@ void Assembler::movq(Operand& dst, Immediate src) {
 }
 
 
+void Assembler::movl(Register dst, Register src) {
+  // Upper half of `dst` is zeroed
+  if (dst.high() == 1 || src.high() == 1) {
+    emitb(0x40 | dst.high() << 2 | src.high());
+  }
+  emitb(0x8B);
+  emit_modrm(dst, src);
+}
+
+
+void Assembler::movl(Operand& dst, Register src) {
+  if (dst.base().high() == 1 || src.high() == 1) {
+    emitb(0x40 | src.high() << 2 | dst.base().high());
+  }
+  emitb(0x89);
+  emit_modrm(src, dst);
+}
+
+
 void Assembler::movl(Operand& dst, Immediate src) {
+  emit_rex_if_high(dst.base());
   emitb(0xC7);
   emit_modrm(dst);
   emitl(src.value());
 }
 
 
+void Assembler::movsxlq(Register dst, Register src) {
+  emit_rexw(dst, src);
+  emitb(0x63);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::movb(Register dst, Immediate src) {
   emit_rexw(dst);
   emitb(0xC6);
@@ -247,7 +315,7 @@ void Assembler::movb(Operand& dst, Immediate src) {
 
 
 void Assembler::movb(Operand& dst, Register src) {
-  emit_rexw(dst);
+  emit_rexw(src, dst);
   emitb(0x88);
   emit_modrm(src, dst);
 }
@@ -297,6 +365,14 @@ void Assembler::imulq(Register src) {
 }
 
 
+void Assembler::imulq(Register dst, Register src) {
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0xAF);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::idivq(Register src) {
   emit_rexw(rax, src);
   emitb(0xF7);
@@ -304,6 +380,12 @@ void Assembler::idivq(Register src) {
 }
 
 
+void Assembler::cqo() {
+  emit_rexw(rax, rax);
+  emitb(0x99);
+}
+
+
 void Assembler::andq(Register dst, Register src) {
   emit_rexw(dst, src);
   emitb(0x23);
@@ -326,6 +408,14 @@ void Assembler::orqb(Register dst, Immediate src) {
 }
 
 
+void Assembler::orb(Operand& dst, Immediate src) {
+  emit_rexw(dst);
+  emitb(0x80);
+  emit_modrm(dst, 1);
+  emitb(src.value());
+}
+
+
 void Assembler::xorq(Register dst, Register src) {
   emit_rexw(dst, src);
   emitb(0x33);
@@ -347,6 +437,13 @@ void Assembler::dec(Register dst) {
 }
 
 
+void Assembler::dec(Operand& dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 0x01);
+}
+
+
 void Assembler::shl(Register dst, Immediate src) {
   emit_rexw(rax, dst);
   emitb(0xC1);
@@ -363,6 +460,42 @@ void Assembler::shr(Register dst, Immediate src) {
 }
 
 
+void Assembler::sar(Register dst, Immediate src) {
+  emit_rexw(rax, dst);
+  emitb(0xC1);
+  emit_modrm(dst, 0x07);
+  emitb(src.value());
+}
+
+
+void Assembler::shll_cl(Register dst) {
+  emit_rex_if_high(dst);
+  emitb(0xD3);
+  emit_modrm(dst, 0x04);
+}
+
+
+void Assembler::shrl_cl(Register dst) {
+  emit_rex_if_high(dst);
+  emitb(0xD3);
+  emit_modrm(dst, 0x05);
+}
+
+
+void Assembler::sarl_cl(Register dst) {
+  emit_rex_if_high(dst);
+  emitb(0xD3);
+  emit_modrm(dst, 0x07);
+}
+
+
+void Assembler::callq(Label* label) {
+  emitb(0xE8);
+  emitl(0x12345678);
+  label->use(offset() - 4);
+}
+
+
 void Assembler::callq(Register dst) {
   emit_rexw(rax, dst);
   emitb(0xFF);
@@ -389,6 +522,15 @@ void Assembler::movqd(DoubleRegister dst, Register src) {
 }
 
 
+void Assembler::movqd(DoubleRegister dst, Operand& src) {
+  emitb(0x66);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x6E);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::movqd(Register dst, DoubleRegister src) {
   emitb(0x66);
   emit_rexw(src, dst);
@@ -455,4 +597,19 @@ void Assembler::cvtsi2sd(DoubleRegister dst, Register src) {
   emit_modrm(dst, src);
 }
 
+void Assembler::cvttsd2si(Register dst, DoubleRegister src) {
+  emitb(0xF2);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x2C);
+  emit_modrm(dst, src);
+}
+
+void Assembler::ucomisd(DoubleRegister dst, DoubleRegister src) {
+  emitb(0x66);
+  emitb(0x0F);
+  emitb(0x2E);
+  emit_modrm(dst, src);
+}
+
 } // namespace candor
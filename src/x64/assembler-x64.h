@@ -4,6 +4,7 @@
 #include <stdint.h> // uint32_t
 #include <stdlib.h> // NULL
 #include <string.h> // memset
+#include <assert.h> // assert
 
 #include "zone.h" // ZoneObject
 #include "utils.h" // List
@@ -204,9 +205,39 @@ enum Condition {
   kGt,
   kGe,
   kCarry,
-  kOverflow
+  kOverflow,
+  kNoOverflow,
+
+  // Unsigned conditions (used for doubles' comparison)
+  kBelow,
+  kBelowEq,
+  kAbove,
+  kAboveEq,
+
+  // Set on unordered comparison of doubles (i.e. with NaN)
+  kParity
 };
 
+// Returns condition that holds whenever `cond` doesn't
+// (only for comparison conditions)
+inline Condition NegateCondition(Condition cond) {
+  switch (cond) {
+   case kEq: return kNe;
+   case kNe: return kEq;
+   case kLt: return kGe;
+   case kLe: return kGt;
+   case kGt: return kLe;
+   case kGe: return kLt;
+   case kOverflow: return kNoOverflow;
+   case kNoOverflow: return kOverflow;
+   case kBelow: return kAboveEq;
+   case kBelowEq: return kAbove;
+   case kAbove: return kBelowEq;
+   case kAboveEq: return kBelow;
+   default: assert(0 && "Unexpected"); return cond;
+  }
+}
+
 class Assembler {
  public:
   Assembler() : offset_(0), length_(256) {
@@ -232,6 +263,7 @@ class Assembler {
   void bind(Label* label);
   void jmp(Label* label);
   void jmp(Condition cond, Label* label);
+  void jmp(Register dst);
 
   void cmpq(Register dst, Register src);
   void cmpq(Register dst, Operand& src);
@@ -239,15 +271,20 @@ class Assembler {
   void cmpq(Operand& dst, Immediate src);
   void cmpb(Register dst, Operand& src);
   void cmpb(Operand& dst, Immediate src);
+  void cmpl(Operand& dst, Immediate src);
 
   void testb(Register dst, Immediate src);
+  void testl(Operand& dst, Immediate src);
 
   void movq(Register dst, Register src);
   void movq(Register dst, Operand& src);
   void movq(Operand& dst, Register src);
   void movq(Register dst, Immediate src);
   void movq(Operand& dst, Immediate src);
+  void movl(Register dst, Register src);
+  void movl(Operand& dst, Register src);
   void movl(Operand& dst, Immediate src);
+  void movsxlq(Register dst, Register src);
   void movb(Register dst, Immediate src);
   void movb(Operand& dst, Immediate src);
   void movb(Operand& dst, Register src);
@@ -258,23 +295,35 @@ class Assembler {
   void subq(Register dst, Register src);
   void subq(Register dst, Immediate src);
   void imulq(Register src);
+  void imulq(Register dst, Register src);
   void idivq(Register src);
+  void cqo();
 
   void andq(Register dst, Register src);
   void orq(Register dst, Register src);
   void orqb(Register dst, Immediate src);
+  void orb(Operand& dst, Immediate src);
   void xorq(Register dst, Register src);
 
   void inc(Register dst);
   void dec(Register dst);
+  void dec(Operand& dst);
   void shl(Register dst, Immediate src);
   void shr(Register dst, Immediate src);
+  void sar(Register dst, Immediate src);
+
+  // 32bit shifts by cl
+  void shll_cl(Register dst);
+  void shrl_cl(Register dst);
+  void sarl_cl(Register dst);
 
+  void callq(Label* label);
   void callq(Register dst);
   void callq(Operand& dst);
 
   // Floating point instructions
   void movqd(DoubleRegister dst, Register src);
+  void movqd(DoubleRegister dst, Operand& src);
   void movqd(Register dst, DoubleRegister src);
   void movqd(Operand& dst, DoubleRegister src);
   void addqd(DoubleRegister dst, DoubleRegister src);
@@ -283,6 +332,8 @@ class Assembler {
   void divqd(DoubleRegister dst, DoubleRegister src);
   void xorqd(DoubleRegister dst, DoubleRegister src);
   void cvtsi2sd(DoubleRegister dst, Register src);
+  void cvttsd2si(Register dst, DoubleRegister src);
+  void ucomisd(DoubleRegister dst, DoubleRegister src);
 
   // Routines
   inline void emit_rex_if_high(Register src);
@@ -295,6 +346,7 @@ class Assembler {
   inline void emit_rexw(Register dst, DoubleRegister src);
   inline void emit_rexw(DoubleRegister dst, Operand& src);
 
+  inline void emit_sib_if_needed(Operand& op);
   inline void emit_modrm(Register dst);
   inline void emit_modrm(Operand &dst);
   inline void emit_modrm(Register dst, Register src);
@@ -41,15 +41,28 @@ Fullgen::Fullgen(Heap* heap) : Masm(heap),
                                Visitor(kPreorder),
                                heap_(heap),
                                visitor_type_(kSlot),
+                               double_box_(-1),
+                               stack_box_(-1),
+                               condition_site_(NULL),
+                               loop_depth_(0),
+                               tail_call_(false),
                                current_function_(NULL) {
-  stubs()->fullgen(this);
-
-  // Create a `global` object
-  root_context()->Push(HObject::NewEmpty(heap, NULL));
+  stubs()->fns(fns());
 }
 
 
 void Fullgen::CandorFunction::Generate() {
+  // Heap keeps feedback as long as the code lives
+  feedback_ = new FeedbackVector(fn(), fn()->offset_, fn()->length_);
+  fullgen()->heap()->feedback()->Push(feedback_);
+
+  // Deoptimized code restarts function from it's entry (see LGen)
+  feedback_->AddResumePoint(fn(), masm()->offset());
+
+  // Root function is called only from C++
+  Label adaptor(masm()), fast(masm());
+  if (!fn()->is_root()) fullgen()->GenerateEntry(fn(), &adaptor, &fast);
+
   // Generate function's body
   fullgen()->GeneratePrologue(fn());
   fullgen()->VisitChildren(fn());
@@ -59,10 +72,17 @@ void Fullgen::CandorFunction::Generate() {
   masm()->movq(rax, 0);
 
   fullgen()->GenerateEpilogue(fn());
+
+  if (!fn()->is_root()) fullgen()->GenerateAdaptor(fn(), &adaptor, &fast);
 }
 
 
 void Fullgen::Generate(AstNode* ast) {
+  // Cells of global variables come first in root context
+  // (see Scope::Analyze), they're nil until assigned
+  int32_t cells = FunctionLiteral::Cast(ast)->global_slots();
+  for (int32_t i = 0; i < cells; i++) root_context()->Push(NULL);
+
   fns_.Push(new CandorFunction(this, FunctionLiteral::Cast(ast)));
 
   FFunction* fn;
@@ -81,10 +101,46 @@ void Fullgen::Generate(AstNode* ast) {
 }
 
 
+void Fullgen::GenerateEntry(AstNode* stmt, Label* adaptor, Label* fast) {
+  uint32_t start = offset();
+  uint32_t args = FunctionLiteral::Cast(stmt)->args()->length();
+
+  // Instructions have fixed size, direct calls may skip them
+  // (see RecordCallTarget)
+  cmpq(rsi, Immediate(TagNumber(args)));
+  jmp(kLt, adaptor);
+  assert(offset() - start == kFastEntryOffset);
+  (void) start;
+
+  bind(fast);
+}
+
+
+void Fullgen::GenerateAdaptor(AstNode* stmt, Label* adaptor, Label* fast) {
+  bind(adaptor);
+
+  // Registers of missing arguments hold caller's junk,
+  // missing stack arguments are checked by prologue
+  uint32_t args = FunctionLiteral::Cast(stmt)->args()->length();
+  for (uint32_t i = 0; i < args && i < kArgRegisterCount; i++) {
+    Label present(this);
+    cmpq(rsi, Immediate(TagNumber(i + 1)));
+    jmp(kGe, &present);
+    movq(ArgRegister(i), Immediate(Heap::kTagNil));
+    bind(&present);
+  }
+
+  jmp(fast);
+}
+
+
 void Fullgen::GeneratePrologue(AstNode* stmt) {
   // rdi <- reference to parent context (zero for root)
-  // rsi <- arguments count
+  // rsi <- tagged arguments count (GC may see it)
+  // rdx, rcx, r8, r9 <- first arguments (see Masm::ArgRegister)
   // rdx <- (root only) address of root context
+  if (!stmt->is_root()) GenerateTierUp();
+
   push(rbp);
   push(rbx);
 
@@ -119,9 +175,13 @@ void Fullgen::GeneratePrologue(AstNode* stmt) {
   uint32_t on_stack_size = 8 + RoundUp((stmt->stack_slots() + 1) * 8, 16);
   subq(rsp, Immediate(on_stack_size));
 
-  // Allocate context and clear stack slots
-  AllocateContext(stmt->context_slots());
+  // Allocate context (functions without context variables keep parent's
+  // one, see ScopeSlot::depth(), root has no parent) and clear stack slots
+  if (stmt->is_root() || stmt->context_slots() != 0) {
+    AllocateContext(stmt->context_slots());
+  }
   FillStackSlots(on_stack_size >> 3);
+  LoadDisplay(FunctionLiteral::Cast(stmt));
 
   // Store root stack address(rbp) to heap
   // It's needed to unwind stack on exceptions
@@ -135,14 +195,22 @@ void Fullgen::GeneratePrologue(AstNode* stmt) {
   uint32_t i = 0;
   while (item != NULL) {
     Operand lhs(rax, 0);
-    Operand rhs(rbp, 24 + 8 * i++);
 
-    cmpq(rsi, Immediate(i));
-    jmp(kLt, &body);
+    if (i < kArgRegisterCount) {
+      // Entry has already checked arguments count
+      VisitForSlot(item->value(), &lhs, scratch);
+      movq(lhs, ArgRegister(i++));
+    } else {
+      Operand rhs(rbp, 24 + 8 * (i++ - kArgRegisterCount));
+
+      cmpq(rsi, Immediate(TagNumber(i)));
+      jmp(kLt, &body);
 
-    VisitForSlot(item->value(), &lhs, scratch);
-    movq(scratch, rhs);
-    movq(lhs, scratch);
+      // Context slot's base shouldn't be overwritten by argument
+      VisitForSlot(item->value(), &lhs, rax);
+      movq(scratch, rhs);
+      movq(lhs, scratch);
+    }
 
     item = item->next();
   }
@@ -155,6 +223,77 @@ void Fullgen::GeneratePrologue(AstNode* stmt) {
 }
 
 
+void Fullgen::GenerateTierUp() {
+  FeedbackVector* vector = current_function()->feedback();
+  Label unoptimized(this), prologue(this);
+  Operand qcode(scratch, 0);
+  Operand qcounter(scratch, 0);
+
+  // Jump into optimized code if there's one
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(vector->code_addr())));
+  movq(scratch, qcode);
+  cmpq(scratch, Immediate(0));
+  jmp(kEq, &unoptimized);
+  jmp(scratch);
+
+  bind(&unoptimized);
+
+  // Count calls, and optimize function once it becomes hot
+  movq(scratch,
+       Immediate(reinterpret_cast<uint64_t>(vector->counter_addr())));
+  dec(qcounter);
+  jmp(kNe, &prologue);
+
+  // Stub(vector), stack is aligned after push
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(vector)));
+  push(rax);
+  Call(stubs()->GetOptimizeStub());
+  // Stub will unwind stack automatically
+
+  cmpq(rax, Immediate(0));
+  jmp(kEq, &prologue);
+  jmp(rax);
+
+  bind(&prologue);
+  xorq(scratch, scratch);
+}
+
+
+void Fullgen::GenerateOsr(AstNode* loop) {
+  FeedbackVector* vector = current_function()->feedback();
+  Label cold(this);
+  Operand qcounter(scratch, 0);
+
+  // Count iterations
+  movq(scratch,
+       Immediate(reinterpret_cast<uint64_t>(vector->osr_counter_addr())));
+  dec(qcounter);
+  jmp(kNe, &cold);
+
+  {
+    // Stub(vector, loop)
+    ChangeAlign(2);
+    Align a(this);
+
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(vector)));
+    push(rax);
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(loop)));
+    push(rax);
+    Call(stubs()->GetOsrStub());
+    // Stub will unwind stack automatically
+    ChangeAlign(-2);
+  }
+
+  // Optimized code takes over current frame and never returns here
+  cmpq(rax, Immediate(0));
+  jmp(kEq, &cold);
+  jmp(rax);
+
+  bind(&cold);
+  xorq(scratch, scratch);
+}
+
+
 void Fullgen::GenerateEpilogue(AstNode* stmt) {
   // rax will hold result of function
   movq(rsp, rbp);
@@ -173,11 +312,16 @@ void Fullgen::GenerateEpilogue(AstNode* stmt) {
 }
 
 
-void Fullgen::PlaceInRoot(char* addr) {
-  Operand root_op(root_reg, 8 * (3 + root_context()->length()));
-  movq(result(), root_op);
-
+int32_t Fullgen::PlaceInRoot(char* addr) {
   root_context()->Push(addr);
+
+  return root_context()->length() - 1;
+}
+
+
+void Fullgen::LoadRoot(int32_t index) {
+  Operand root_op(root_reg, 8 * (3 + index));
+  movq(result(), root_op);
 }
 
 
@@ -186,14 +330,60 @@ char* Fullgen::AllocateRoot() {
 }
 
 
+// Arithmetic binop that may produce heap number
+static bool IsMath(AstNode* node) {
+  return node->is(AstNode::kBinOp) && BinOp::Cast(node)->is_math();
+}
+
+
+// Returns true if expression can't invoke any candor function
+// (stubs and runtime calls are fine)
+static bool IsCallFree(AstNode* node) {
+  switch (node->type()) {
+   case AstNode::kNumber:
+   case AstNode::kNil:
+   case AstNode::kTrue:
+   case AstNode::kFalse:
+   case AstNode::kString:
+   case AstNode::kProperty:
+   case AstNode::kValue:
+   case AstNode::kMember:
+   case AstNode::kBinOp:
+   case AstNode::kUnOp:
+    break;
+   default:
+    return false;
+  }
+
+  AstList::Item* item = node->children()->head();
+  for (; item != NULL; item = item->next()) {
+    if (!IsCallFree(item->value())) return false;
+  }
+
+  return true;
+}
+
+
 AstNode* Fullgen::VisitForValue(AstNode* node, Register reg) {
+  return VisitForValue(node, reg, -1);
+}
+
+
+AstNode* Fullgen::VisitForValue(AstNode* node,
+                                Register reg,
+                                int32_t double_box,
+                                int32_t stack_box) {
   // Save previous data
   Register stored = result_;
   VisitorType stored_type = visitor_type_;
+  int32_t stored_box = double_box_;
+  int32_t stored_stack_box = stack_box_;
 
   // Set new
   result_ = reg;
   visitor_type_ = kValue;
+  double_box_ = double_box;
+  stack_box_ = stack_box;
 
   // Visit node
   AstNode* result = Visit(node);
@@ -201,21 +391,44 @@ AstNode* Fullgen::VisitForValue(AstNode* node, Register reg) {
   // Restore
   result_ = stored;
   visitor_type_ = stored_type;
+  double_box_ = stored_box;
+  stack_box_ = stored_stack_box;
 
   return result;
 }
 
 
+AstNode* Fullgen::VisitForOperand(AstNode* node,
+                                  Register reg,
+                                  int32_t double_box) {
+  if (node->is(AstNode::kValue) && AstValue::Cast(node)->is_slot()) {
+    ScopeSlot* slot = AstValue::Cast(node)->slot();
+
+    if (slot->has_mutable_box()) {
+      Operand value(rbp, -8 * (slot->index() + 1));
+      movq(reg, value);
+      return node;
+    }
+  }
+
+  return VisitForValue(node, reg, double_box);
+}
+
+
 AstNode* Fullgen::VisitForSlot(AstNode* node, Operand* op, Register base) {
   // Save data
   Operand* stored = slot_;
   Register stored_base = result_;
   VisitorType stored_type = visitor_type_;
+  int32_t stored_box = double_box_;
+  int32_t stored_stack_box = stack_box_;
 
   // Set new
   slot_ = op;
   result_ = base;
   visitor_type_ = kSlot;
+  double_box_ = -1;
+  stack_box_ = -1;
 
   // Visit node
   AstNode* result = Visit(node);
@@ -224,6 +437,8 @@ AstNode* Fullgen::VisitForSlot(AstNode* node, Operand* op, Register base) {
   slot_ = stored;
   result_ = stored_base;
   visitor_type_ = stored_type;
+  double_box_ = stored_box;
+  stack_box_ = stored_stack_box;
 
   return result;
 }
@@ -269,6 +484,13 @@ AstNode* Fullgen::VisitFunction(AstNode* stmt) {
 
 AstNode* Fullgen::VisitCall(AstNode* stmt) {
   FunctionLiteral* fn = FunctionLiteral::Cast(stmt);
+  FeedbackSite* site = NULL;
+  uint32_t args = fn->args()->length();
+
+  // Only call of `return` statement can replace frame, and only if
+  // it doesn't have stack arguments that caller won't unwind
+  bool tail = tail_call_ && args <= kArgRegisterCount;
+  tail_call_ = false;
 
   Label not_function(this), done(this);
 
@@ -301,17 +523,36 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
       return stmt;
     }
 
+    site = AddSite(FeedbackSite::kCall);
+    stmt->feedback(site);
+
     // Save rax if we're not going to overwrite it
     Save(rax);
 
-    // Save old context
-    Save(rdi);
+    // Save old context (frame is left on tail call)
+    if (!tail) Save(rdi);
 
     VisitForValue(fn->variable(), rax);
+
+    // Function that site has called last time is known to be a function
+    Label checked(this);
+    Operand cached(scratch, 0);
+    movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->function_addr())));
+    cmpq(rax, cached);
+    jmp(kEq, &checked);
+
     IsNil(rax, NULL, &not_function);
     IsHeapObject(Heap::kTagFunction, rax, &not_function, NULL);
 
-    ChangeAlign(fn->args()->length());
+    // rsi will be overwritten by arguments anyway
+    RecordCallTarget(site, rax, rsi, args);
+    bind(&checked);
+
+    // Last pushed arguments are passed in registers
+    uint32_t in_registers = args < kArgRegisterCount ? args :
+                                                       kArgRegisterCount;
+    uint32_t on_stack = args - in_registers;
+    ChangeAlign(on_stack);
 
     {
       Align a(this);
@@ -325,21 +566,32 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
         ChangeAlign(1);
         item = item->next();
       }
+
+      // Nothing can allocate after that, so GC won't miss them
+      for (uint32_t i = 0; i < in_registers; i++) {
+        pop(ArgRegister(i));
+        ChangeAlign(-1);
+      }
+
       // Restore alignment
-      ChangeAlign(-fn->args()->length());
+      ChangeAlign(-on_stack);
 
       // Generate calling code
-      Call(rax, fn->args()->length());
+      if (tail) {
+        TailCall(site, rax, args);
+      } else {
+        Call(site, rax, args);
+      }
 
-      if (fn->args()->length() != 0) {
+      if (on_stack != 0) {
         // Unwind stack
-        addq(rsp, Immediate(fn->args()->length() * 8));
+        addq(rsp, Immediate(on_stack * 8));
       }
     }
 
     // Finally restore everything
-    ChangeAlign(-fn->args()->length());
-    Restore(rdi);
+    ChangeAlign(-on_stack);
+    if (!tail) Restore(rdi);
 
     // Restore rax and set result if needed
     Result(rax);
@@ -349,6 +601,7 @@ AstNode* Fullgen::VisitCall(AstNode* stmt) {
   jmp(&done);
   bind(&not_function);
 
+  if (site != NULL) RecordFeedback(site, FeedbackSite::kGeneric);
   movq(result(), Immediate(Heap::kTagNil));
 
   bind(&done);
@@ -361,8 +614,26 @@ AstNode* Fullgen::VisitAssign(AstNode* stmt) {
   Save(rax);
   Save(rbx);
 
+  ScopeSlot* boxed = NULL;
+  if (stmt->lhs()->is(AstNode::kValue) &&
+      AstValue::Cast(stmt->lhs())->is_slot() &&
+      AstValue::Cast(stmt->lhs())->slot()->has_mutable_box()) {
+    boxed = AstValue::Cast(stmt->lhs())->slot();
+  }
+
   // Get value of right-hand side expression in rbx
-  VisitForValue(stmt->rhs(), rbx);
+  if (boxed == NULL) {
+    VisitForValue(stmt->rhs(), rbx);
+  } else if (stmt->rhs()->is(AstNode::kBinOp) &&
+             BinOp::Cast(stmt->rhs())->is_math()) {
+    // Arithmetic result may be stored in slot's heap number
+    VisitForValue(stmt->rhs(), rbx, -1, boxed->index());
+  } else {
+    // Slot should own it's heap number, literals and other variables
+    // can't be updated in place
+    VisitForValue(stmt->rhs(), rbx);
+    CloneNumber(rbx);
+  }
 
   // Get target slot for left-hand side
   Operand lhs(rax, 0);
@@ -411,27 +682,24 @@ AstNode* Fullgen::VisitValue(AstNode* node) {
   } else {
     int32_t depth = value->slot()->depth();
 
-    if (depth == -2) {
-      // Root register lookup
+    if (depth == -1) {
+      // Global variable's cell in root context
       slot()->base(root_reg);
       slot()->disp(8 * (value->slot()->index() + 3));
-    } else if (depth == -1) {
-      // Global lookup
-      slot()->base(root_reg);
-      slot()->disp(24);
-
-      AstNode* member = new AstNode(AstNode::kMember);
-      member->children()->Push(new FAstOperand(slot()));
-      member->children()->Push(value->name());
-      VisitForSlot(member, slot(), result());
     } else {
       // Context variables
-      movq(result(), rdi);
-
-      // Lookup context
-      while (--depth >= 0) {
-        Operand parent(result(), 8);
-        movq(result(), parent);
+      int32_t display = current_function()->fn()->DisplaySlot(depth);
+      if (display != -1) {
+        Operand cached(rbp, -8 * (display + 1));
+        movq(result(), cached);
+      } else {
+        movq(result(), rdi);
+
+        // Lookup context
+        while (--depth >= 0) {
+          Operand parent(result(), 8);
+          movq(result(), parent);
+        }
       }
 
       slot()->base(result());
@@ -444,6 +712,9 @@ AstNode* Fullgen::VisitValue(AstNode* node) {
   // If we was asked to return value - dereference slot
   if (visiting_for_value()) {
     movq(result(), *slot());
+
+    // Mutable box can't leak out of slot
+    if (value->slot()->has_mutable_box()) CloneNumber(result());
   }
 
   return node;
@@ -451,16 +722,19 @@ AstNode* Fullgen::VisitValue(AstNode* node) {
 
 
 AstNode* Fullgen::VisitMember(AstNode* node) {
-  Label nil_error(this), non_object_error(this), done(this);
+  Label nil_error(this), non_object_error(this), nil_result(this), done(this);
+  FeedbackSite* site = AddSite(FeedbackSite::kMember);
+  node->feedback(site);
 
   VisitForValue(node->lhs(), result());
 
   // Throw error if we're trying to lookup into nil object
-  IsNil(result(), NULL, &non_object_error);
+  IsNil(result(), NULL, &nil_error);
   IsUnboxed(result(), NULL, &non_object_error);
 
   // Or into non-object
   IsHeapObject(Heap::kTagObject, result(), &non_object_error, NULL);
+  RecordFeedback(site, FeedbackSite::kObject);
 
   // Calculate hash of property
 
@@ -495,9 +769,15 @@ AstNode* Fullgen::VisitMember(AstNode* node) {
 
   jmp(&done);
 
+  bind(&nil_error);
+  RecordFeedback(site, FeedbackSite::kNil);
+  jmp(&nil_result);
+
   bind(&non_object_error);
+  RecordFeedback(site, FeedbackSite::kGeneric);
 
   // Non object lookups will return nil
+  bind(&nil_result);
   movq(result(), Immediate(Heap::kTagNil));
 
   bind(&done);
@@ -512,17 +792,29 @@ AstNode* Fullgen::VisitNumber(AstNode* node) {
     return node;
   }
 
-  if (StringIsDouble(node->value(), node->length())) {
-    // Allocate boxed heap number
-    double value = StringToDouble(node->value(), node->length());
+  bool is_double = StringIsDouble(node->value(), node->length());
+  if (!is_double) {
+    uint64_t value = StringToInt(node->value(), node->length());
 
-    PlaceInRoot(HNumber::New(heap(), NULL, value));
-  } else {
-    // Allocate unboxed number
-    int64_t value = StringToInt(node->value(), node->length());
-    movq(result(), Immediate(TagNumber(value)));
+    // Allocate unboxed number, if it fits into 63 bits
+    if (value < (1ULL << 62)) {
+      movq(result(), Immediate(TagNumber(value)));
+      return node;
+    }
   }
 
+  // Allocate boxed heap number, once for all uses of the literal
+  FLiteral* literal = numbers_.Get(node->value(), node->length());
+  if (literal == NULL) {
+    double value = is_double ?
+        StringToDouble(node->value(), node->length()) :
+        static_cast<double>(StringToInt(node->value(), node->length()));
+
+    literal = new FLiteral(PlaceInRoot(HNumber::New(heap(), NULL, value)));
+    numbers_.Set(node->value(), node->length(), literal);
+  }
+  LoadRoot(literal->index());
+
   return node;
 }
 
@@ -533,7 +825,15 @@ AstNode* Fullgen::VisitString(AstNode* node) {
     return node;
   }
 
-  PlaceInRoot(HString::New(heap(), NULL, node->value(), node->length()));
+  // Literals are interned, so same strings will share storage,
+  // and every string takes one root slot
+  FLiteral* literal = strings_.Get(node->value(), node->length());
+  if (literal == NULL) {
+    literal = new FLiteral(PlaceInRoot(
+        HString::NewSymbol(heap(), node->value(), node->length())));
+    strings_.Set(node->value(), node->length(), literal);
+  }
+  LoadRoot(literal->index());
 
   return node;
 }
@@ -545,19 +845,55 @@ AstNode* Fullgen::VisitProperty(AstNode* node) {
 }
 
 
-void Fullgen::ConvertToBoolean() {
-  Label not_bool(this), coerced_type(this);
+void Fullgen::BranchOnValue(Label* is_true,
+                            Label* is_false,
+                            FeedbackSite* site) {
+  Label heap_value(this), nil_value(this), not_true(this), not_false(this);
 
-  // Check type and coerce if not boolean
-  IsNil(result(), NULL, &not_bool);
-  IsUnboxed(result(), NULL, &not_bool);
-  IsHeapObject(Heap::kTagBoolean, result(), &not_bool, NULL);
+  // nil is falsy
+  IsNil(result(), NULL, site == NULL ? is_false : &nil_value);
 
-  jmp(&coerced_type);
-  bind(&not_bool);
+  // Unboxed numbers are truthy unless zero
+  IsUnboxed(result(), &heap_value, NULL);
+  if (site != NULL) RecordFeedback(site, FeedbackSite::kSmi);
+  cmpq(result(), Immediate(TagNumber(0)));
+  jmp(kEq, is_false);
+  jmp(is_true);
 
-  // Coerce type to boolean
-  Save(rax);
+  if (site != NULL) {
+    bind(&nil_value);
+    RecordFeedback(site, FeedbackSite::kNil);
+    jmp(is_false);
+  }
+
+  bind(&heap_value);
+
+  // Booleans are singletons, so just compare addresses
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  cmpq(result(), scratch);
+  if (site == NULL) {
+    jmp(kEq, is_true);
+  } else {
+    jmp(kNe, &not_true);
+    RecordFeedback(site, FeedbackSite::kBoolean);
+    jmp(is_true);
+    bind(&not_true);
+  }
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+  cmpq(result(), scratch);
+  if (site == NULL) {
+    jmp(kEq, is_false);
+  } else {
+    jmp(kNe, &not_false);
+    RecordFeedback(site, FeedbackSite::kBoolean);
+    jmp(is_false);
+    bind(&not_false);
+    RecordFeedback(site, FeedbackSite::kGeneric);
+  }
+
+  // Strings, heap numbers and objects are coerced in runtime
+  // (value is preserved, `a && b` in value context relies on that)
+  Push(rax);
   {
     // Stub(value)
     ChangeAlign(1);
@@ -568,10 +904,241 @@ void Fullgen::ConvertToBoolean() {
     // Stub will unwind stack automatically
     ChangeAlign(-1);
   }
-  Result(rax);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  cmpq(rax, scratch);
+
+  // Restoring doesn't affect flags
+  Pop(rax);
+  jmp(kEq, is_true);
+  jmp(is_false);
+}
+
+
+void Fullgen::VisitForControl(AstNode* node, Label* is_true, Label* is_false) {
+  assert(is_true != NULL || is_false != NULL);
+
+  // !expr - just swap targets
+  if (node->is(AstNode::kUnOp) && UnOp::Cast(node)->subtype() == UnOp::kNot) {
+    VisitForControl(node->lhs(), is_false, is_true);
+    return;
+  }
+
+  if (node->is(AstNode::kBinOp)) {
+    BinOp* op = BinOp::Cast(node);
+
+    if (op->is_logic()) {
+      // Short-circuit: rhs is evaluated only if lhs hasn't decided result
+      Label skip_rhs(this);
+      if (op->subtype() == BinOp::kLAnd) {
+        VisitForControl(op->lhs(),
+                        NULL,
+                        is_false == NULL ? &skip_rhs : is_false);
+      } else {
+        VisitForControl(op->lhs(), is_true == NULL ? &skip_rhs : is_true, NULL);
+      }
+      VisitForControl(op->rhs(), is_true, is_false);
+      bind(&skip_rhs);
+      return;
+    }
+
+    if (op->is_compare()) {
+      VisitCompareForControl(op, is_true, is_false);
+      return;
+    }
+  }
+
+  // Generic case: compute value and test it
+  Label fallthrough(this);
+
+  VisitForOperand(node, result(), -1);
+  BranchOnValue(is_true == NULL ? &fallthrough : is_true,
+                is_false == NULL ? &fallthrough : is_false,
+                condition_site_);
+
+  bind(&fallthrough);
+}
+
+
+void Fullgen::VisitCompareForControl(BinOp* op,
+                                     Label* is_true,
+                                     Label* is_false) {
+  Label heap_values(this), not_numbers(this), call_stub(this);
+  Label set_true(this), set_false(this), boolean(this), done(this);
+  FeedbackSite* site = AddSite(FeedbackSite::kBinOp);
+  op->feedback(site);
+
+  Condition cond;
+  BaseStub* stub;
+  switch (op->subtype()) {
+   case BinOp::kEq: cond = kEq; stub = stubs()->GetBinaryEqStub(); break;
+   case BinOp::kStrictEq:
+    cond = kEq;
+    stub = stubs()->GetBinaryStrictEqStub();
+    break;
+   case BinOp::kNe: cond = kNe; stub = stubs()->GetBinaryNeStub(); break;
+   case BinOp::kStrictNe:
+    cond = kNe;
+    stub = stubs()->GetBinaryStrictNeStub();
+    break;
+   case BinOp::kLt: cond = kLt; stub = stubs()->GetBinaryLtStub(); break;
+   case BinOp::kGt: cond = kGt; stub = stubs()->GetBinaryGtStub(); break;
+   case BinOp::kLe: cond = kLe; stub = stubs()->GetBinaryLeStub(); break;
+   case BinOp::kGe: cond = kGe; stub = stubs()->GetBinaryGeStub(); break;
+   default: assert(0 && "Unexpected"); return;
+  }
+
+  Save(rax);
+  Save(rbx);
+
+  VisitForOperand(op->lhs(), rax, -1);
+  VisitForOperand(op->rhs(), rbx, -1);
+
+  // Tagging preserves order of unboxed numbers,
+  // so they can be compared without untagging
+  IsUnboxed(rax, &heap_values, NULL);
+  IsUnboxed(rbx, &heap_values, NULL);
+  RecordFeedback(site, FeedbackSite::kSmi);
+  cmpq(rax, rbx);
+
+  // Restoring doesn't affect flags
+  Restore(rbx);
   Restore(rax);
 
-  bind(&coerced_type);
+  if (is_true == NULL) {
+    jmp(NegateCondition(cond), is_false);
+    jmp(&done);
+  } else {
+    jmp(cond, is_true);
+    jmp(is_false == NULL ? &done : is_false);
+  }
+
+  bind(&heap_values);
+
+  // rax and rbx are still on stack here
+  ChangeAlign(!result().is(rax) + !result().is(rbx));
+
+  // Mixed and heap numbers are compared as doubles
+  LoadNumber(rax, xmm1, &not_numbers);
+  LoadNumber(rbx, xmm2, &not_numbers);
+  RecordFeedback(site, FeedbackSite::kDouble);
+
+  // ucomisd sets flags as an unsigned comparison does,
+  // unordered operands (NaN) set all of ZF, PF and CF
+  switch (cond) {
+   case kLt:
+    ucomisd(xmm2, xmm1);
+    jmp(kAbove, &set_true);
+    break;
+   case kLe:
+    ucomisd(xmm2, xmm1);
+    jmp(kAboveEq, &set_true);
+    break;
+   case kGt:
+    ucomisd(xmm1, xmm2);
+    jmp(kAbove, &set_true);
+    break;
+   case kGe:
+    ucomisd(xmm1, xmm2);
+    jmp(kAboveEq, &set_true);
+    break;
+   case kEq:
+    ucomisd(xmm1, xmm2);
+    jmp(kParity, &set_false);
+    jmp(kEq, &set_true);
+    break;
+   case kNe:
+    ucomisd(xmm1, xmm2);
+    jmp(kParity, &set_true);
+    jmp(kNe, &set_true);
+    break;
+   default:
+    break;
+  }
+  jmp(&set_false);
+
+  bind(&not_numbers);
+  RecordFeedback(site, FeedbackSite::kGeneric);
+
+  if (cond == kEq || cond == kNe) {
+    Label* equal = cond == kEq ? &set_true : &set_false;
+    Label* not_equal = cond == kEq ? &set_false : &set_true;
+
+    // Any value is equal to itself (numbers were handled above)
+    cmpq(rax, rbx);
+    jmp(kEq, equal);
+
+    // Interned strings are equal only if they're the same object
+    Operand lhs_tag(rax, 0);
+    Operand rhs_tag(rbx, 0);
+    IsNil(rax, NULL, &call_stub);
+    IsUnboxed(rax, NULL, &call_stub);
+    IsHeapObject(Heap::kTagString, rax, &call_stub, NULL);
+    testl(lhs_tag, Immediate(Heap::kImmortalBit));
+    jmp(kEq, &call_stub);
+    IsNil(rbx, NULL, &call_stub);
+    IsUnboxed(rbx, NULL, &call_stub);
+    IsHeapObject(Heap::kTagString, rbx, &call_stub, NULL);
+    testl(rhs_tag, Immediate(Heap::kImmortalBit));
+    jmp(kNe, not_equal);
+  }
+
+  bind(&call_stub);
+  {
+    // Stub(lhs, rhs)
+    ChangeAlign(2);
+    Align a(this);
+
+    push(rax);
+    push(rbx);
+    Call(stub);
+
+    // Caller should unwind stack
+    addq(rsp, 16);
+    ChangeAlign(-2);
+  }
+  jmp(&boolean);
+
+  bind(&set_true);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  jmp(&boolean);
+
+  bind(&set_false);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+
+  bind(&boolean);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  cmpq(rax, scratch);
+
+  Restore(rbx);
+  Restore(rax);
+
+  if (is_true == NULL) {
+    jmp(kNe, is_false);
+  } else {
+    jmp(kEq, is_true);
+    if (is_false != NULL) jmp(is_false);
+  }
+
+  bind(&done);
+}
+
+
+void Fullgen::VisitForBoolean(AstNode* node) {
+  Label is_false(this), done(this);
+
+  // Value isn't a condition of `if` or `while`
+  FeedbackSite* condition_site = condition_site_;
+  condition_site_ = NULL;
+  VisitForControl(node, NULL, &is_false);
+  condition_site_ = condition_site;
+
+  movq(result(), Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  jmp(&done);
+
+  bind(&is_false);
+  movq(result(), Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+
+  bind(&done);
 }
 
 
@@ -584,15 +1151,14 @@ AstNode* Fullgen::VisitIf(AstNode* node) {
   AstNode* fail = NULL;
   if (fail_item != NULL) fail = fail_item->value();
 
-  VisitForValue(expr, result());
-
-  ConvertToBoolean();
-
-  IsTrue(result(), &fail_body, NULL);
+  condition_site_ = AddSite(FeedbackSite::kCondition);
+  node->feedback(condition_site_);
+  VisitForControl(expr, NULL, &fail_body);
+  condition_site_ = NULL;
 
   VisitForValue(success, result());
 
-  jmp(&done);
+  if (fail != NULL) jmp(&done);
   bind(&fail_body);
 
   if (fail != NULL) VisitForValue(fail, result());
@@ -604,24 +1170,33 @@ AstNode* Fullgen::VisitIf(AstNode* node) {
 
 
 AstNode* Fullgen::VisitWhile(AstNode* node) {
-  Label loop_start(this), loop_end(this);
+  Label loop_start(this), loop_cond(this);
 
   AstNode* expr = node->lhs();
   AstNode* body = node->rhs();
 
-  bind(&loop_start);
+  // Condition is placed after the body,
+  // so every iteration ends with a single conditional jump
+  jmp(&loop_cond);
 
-  VisitForValue(expr, result());
+  bind(&loop_start);
 
-  ConvertToBoolean();
+  loop_depth_++;
+  VisitForValue(body, result());
+  loop_depth_--;
 
-  IsTrue(result(), &loop_end, NULL);
+  bind(&loop_cond);
 
-  VisitForValue(body, result());
+  // Deoptimized code continues here with values of loop's header
+  current_function()->feedback()->AddResumePoint(node, offset());
 
-  jmp(&loop_start);
+  // Only outermost loops are replaced, optimized code will run inner ones
+  if (loop_depth_ == 0) GenerateOsr(node);
 
-  bind(&loop_end);
+  condition_site_ = AddSite(FeedbackSite::kCondition);
+  node->feedback(condition_site_);
+  VisitForControl(expr, &loop_start, NULL);
+  condition_site_ = NULL;
 
   return node;
 }
@@ -645,7 +1220,9 @@ AstNode* Fullgen::VisitTrue(AstNode* node) {
     return node;
   }
 
-  PlaceInRoot(HBoolean::New(heap(), NULL, true));
+  // Booleans are immortal and never move
+  movq(result(), Immediate(reinterpret_cast<uint64_t>(
+      HBoolean::New(heap(), NULL, true))));
 
   return node;
 }
@@ -657,7 +1234,9 @@ AstNode* Fullgen::VisitFalse(AstNode* node) {
     return node;
   }
 
-  PlaceInRoot(HBoolean::New(heap(), NULL, false));
+  // Booleans are immortal and never move
+  movq(result(), Immediate(reinterpret_cast<uint64_t>(
+      HBoolean::New(heap(), NULL, false))));
 
   return node;
 }
@@ -670,18 +1249,48 @@ AstNode* Fullgen::VisitObjectLiteral(AstNode* node) {
   }
 
   ObjectLiteral* obj = ObjectLiteral::Cast(node);
+  assert(obj->keys()->length() == obj->values()->length());
 
   Save(rax);
   Save(rbx);
 
+  AstList::Item* key = obj->keys()->head();
+  AstList::Item* value = obj->values()->head();
+
+  if (obj->keys()->length() <= kMaxBoilerplateKeys) {
+    uint32_t offsets[kMaxBoilerplateKeys];
+    bool is_inline = AllocateObjectLiteral(obj, offsets, rax);
+
+    // Store values directly into their slots
+    for (uint32_t i = 0; value != NULL; value = value->next(), i++) {
+      VisitForValue(value->value(), rbx);
+
+      if (is_inline) {
+        Operand qvalue(rax, offsets[i]);
+        movq(qvalue, rbx);
+        continue;
+      }
+
+      // Map may have been moved by GC
+      Operand qmap(rax, 16);
+      Operand qvalue(scratch, offsets[i]);
+      movq(scratch, qmap);
+      movq(qvalue, rbx);
+    }
+    xorq(scratch, scratch);
+
+    Result(rax);
+    Restore(rbx);
+    Restore(rax);
+
+    return node;
+  }
+
   // Ensure that map will be filled only by half at maximum
-  movq(rbx, Immediate(TagNumber(PowerOfTwo(node->children()->length() << 1))));
+  movq(rbx, Immediate(TagNumber(PowerOfTwo(obj->keys()->length() << 1))));
   AllocateObjectLiteral(rbx, rax);
 
   // Set every key/value pair
-  assert(obj->keys()->length() == obj->values()->length());
-  AstList::Item* key = obj->keys()->head();
-  AstList::Item* value = obj->values()->head();
   while (key != NULL) {
     AstNode* member = new AstNode(AstNode::kMember);
     member->children()->Push(new FAstRegister(rax));
@@ -723,10 +1332,11 @@ AstNode* Fullgen::VisitArrayLiteral(AstNode* node) {
   AstList::Item* item = node->children()->head();
   uint64_t index = 0;
   while (item != NULL) {
-    char keystr[32];
+    // Literal pool keeps a pointer to the key's text
+    char* keystr = Zone::NewArray<char>(32);
     AstNode* key = new AstNode(AstNode::kProperty);
     key->value(keystr);
-    key->length(snprintf(keystr, sizeof(keystr), "%llu", index));
+    key->length(snprintf(keystr, 32, "%llu", index));
 
     AstNode* member = new AstNode(AstNode::kMember);
     member->children()->Push(new FAstRegister(rax));
@@ -748,10 +1358,10 @@ AstNode* Fullgen::VisitArrayLiteral(AstNode* node) {
     key->value("length");
     key->length(6);
 
-    char lenstr[32];
+    char* lenstr = Zone::NewArray<char>(32);
     AstNode* value = new AstNode(AstNode::kNumber);
     value->value(lenstr);
-    value->length(snprintf(lenstr, sizeof(lenstr), "%llu", index));
+    value->length(snprintf(lenstr, 32, "%llu", index));
 
     // arr.length = num
     AstNode* member = new AstNode(AstNode::kMember);
@@ -775,8 +1385,14 @@ AstNode* Fullgen::VisitArrayLiteral(AstNode* node) {
 
 AstNode* Fullgen::VisitReturn(AstNode* node) {
   if (node->lhs() != NULL) {
+    // Call in tail position reuses function's frame (see VisitCall),
+    // root function's frame is the boundary with C++
+    tail_call_ = node->lhs()->is(AstNode::kCall) &&
+                 !current_function()->fn()->is_root();
+
     // Get value of expression
     VisitForValue(node->lhs(), rax);
+    tail_call_ = false;
   } else {
     // Or just nullify output
     movq(rax, Immediate(0));
@@ -824,6 +1440,7 @@ AstNode* Fullgen::VisitUnOp(AstNode* node) {
     // ++a => a = a + 1
     if (op->subtype() == UnOp::kPreInc || op->subtype() == UnOp::kPreDec) {
       Visit(assign);
+      op->feedback(rhs->feedback());
       return node;
     }
 
@@ -847,6 +1464,7 @@ AstNode* Fullgen::VisitUnOp(AstNode* node) {
     assign->children()->head()->value(new FAstOperand(&result_slot));
     rhs->children()->head()->value(new FAstRegister(rbx));
     VisitForValue(assign, result());
+    op->feedback(rhs->feedback());
 
     Restore(rbx);
     Restore(rax);
@@ -855,6 +1473,11 @@ AstNode* Fullgen::VisitUnOp(AstNode* node) {
     return node;
   }
 
+  if (op->subtype() == UnOp::kNot) {
+    VisitForBoolean(node);
+    return node;
+  }
+
   // For `nil` any unop will return `nil`
   VisitForValue(op->lhs(), result());
   IsNil(result(), NULL, &done);
@@ -875,115 +1498,257 @@ AstNode* Fullgen::VisitBinOp(AstNode* node) {
     return node;
   }
 
-  Save(rax);
-  Save(rbx);
+  if (op->is_compare()) {
+    VisitForBoolean(node);
+    return node;
+  }
 
-  {
-    // lhs and rhs values will be pushed later
-    ChangeAlign(2);
-    Align a(this);
+  if (op->is_logic()) {
+    Label evaluate_rhs(this), done(this);
 
-    Label not_unboxed(this), done(this);
-    Label lhs_to_heap(this), rhs_to_heap(this);
+    // `a && b` is `a` if it's falsy and `b` otherwise,
+    // `a || b` is `a` if it's truthy and `b` otherwise
+    VisitForValue(op->lhs(), result());
+    if (op->subtype() == BinOp::kLAnd) {
+      BranchOnValue(&evaluate_rhs, &done);
+    } else {
+      BranchOnValue(&done, &evaluate_rhs);
+    }
 
-    VisitForValue(op->lhs(), rax);
-    VisitForValue(op->rhs(), rbx);
+    bind(&evaluate_rhs);
+    VisitForValue(op->rhs(), result());
 
-    // No need to change align here, because it was already changed above
-    push(rax);
-    push(rbx);
+    bind(&done);
+    return node;
+  }
 
-    IsNil(rax, NULL, &not_unboxed);
-    IsNil(rbx, NULL, &not_unboxed);
+  Label heap_values(this), call_stub(this), unboxed_result(this), done(this);
+  FeedbackSite* site = AddSite(FeedbackSite::kBinOp);
+  op->feedback(site);
+
+  // Intermediate double results of nested arithmetic are stored in
+  // immortal boxes instead of new heap numbers, so only the root of an
+  // expression tree allocates. lhs' box stays live while rhs is evaluated,
+  // therefore it's used only if rhs can't reenter generated code.
+  int32_t box = double_box_;
+  int32_t stack_box = stack_box_;
+  int32_t lhs_box = -1;
+  int32_t rhs_box = -1;
+  uint32_t level = box + 1;
+  if (level + 1 < Heap::kDoubleBoxCount) {
+    if (IsMath(op->lhs()) && IsCallFree(op->rhs())) lhs_box = level;
+    if (IsMath(op->rhs())) rhs_box = level + 1;
+  }
 
-    IsUnboxed(rax, &rhs_to_heap, NULL);
-    IsUnboxed(rbx, &lhs_to_heap, NULL);
+  Save(rax);
+  Save(rbx);
 
-    {
-      // Number (+) Number
-      Untag(rax);
-      Untag(rbx);
-
-      switch (op->subtype()) {
-       case BinOp::kAdd: addq(rax, rbx); break;
-       case BinOp::kSub: subq(rax, rbx); break;
-       case BinOp::kMul: push(rdx); imulq(rbx); pop(rdx); break;
-       case BinOp::kDiv: push(rdx); idivq(rbx); pop(rdx); break;
-       case BinOp::kBAnd: andq(rax, rbx); break;
-       case BinOp::kBOr: orq(rax, rbx); break;
-       case BinOp::kBXor: xorq(rax, rbx); break;
-
-       default: emitb(0xcc); break;
-      }
+  VisitForOperand(op->lhs(), rax, lhs_box);
+  VisitForOperand(op->rhs(), rbx, rhs_box);
 
-      // Call stub on overflow
-      jmp(kOverflow, &lhs_to_heap);
+  if (op->is_bitwise()) {
+    Label slow(this);
 
-      TagNumber(rax);
-      jmp(kCarry, &lhs_to_heap);
+    // Operate on int32 values, heap numbers are truncated inline.
+    // No calls here, so stack alignment doesn't matter
+    push(rcx);
+    push(rdx);
 
-      movq(result(), rax);
+    LoadInteger(rax, rdx, &slow);
+    LoadInteger(rbx, rcx, &slow);
+    RecordFeedback(site, FeedbackSite::kSmi);
 
-      jmp(&done);
+    // Only lower 32 bits of operands are used, shift count is
+    // masked by cpu
+    switch (op->subtype()) {
+     case BinOp::kBAnd: andq(rdx, rcx); break;
+     case BinOp::kBOr: orq(rdx, rcx); break;
+     case BinOp::kBXor: xorq(rdx, rcx); break;
+     case BinOp::kShl: shll_cl(rdx); break;
+     case BinOp::kShr: sarl_cl(rdx); break;
+     case BinOp::kUShr: shrl_cl(rdx); break;
+     default: break;
     }
 
-    bind(&lhs_to_heap);
-
-    Pop(rbx);
-    Pop(rax);
+    // int32 (or uint32 for >>>) result always fits into unboxed number
+    if (op->subtype() == BinOp::kUShr) {
+      movl(rdx, rdx);
+    } else {
+      movsxlq(rdx, rdx);
+    }
+    movq(scratch, rdx);
+    TagNumber(scratch);
 
-    Untag(rax);
+    pop(rdx);
+    pop(rcx);
+    jmp(&unboxed_result);
 
-    // Translate lhs to heap number
-    xorqd(xmm1, xmm1);
-    cvtsi2sd(xmm1, rax);
-    AllocateNumber(xmm1, rax);
+    bind(&slow);
+    pop(rdx);
+    pop(rcx);
+    jmp(&call_stub);
+  } else {
+    IsUnboxed(rax, &heap_values, NULL);
+    IsUnboxed(rbx, &heap_values, NULL);
+    RecordFeedback(site, FeedbackSite::kSmi);
 
-    // Replace on-stack value of rax
-    Push(rax);
-    Push(rbx);
+    // Operate on tagged values: (a << 1 | 1) and (b << 1 | 1),
+    // rax and rbx should stay intact for the double path
+    switch (op->subtype()) {
+     case BinOp::kAdd:
+      movq(scratch, rax);
+      subq(scratch, Immediate(1));
+      addq(scratch, rbx);
+      jmp(kOverflow, &heap_values);
+      break;
+     case BinOp::kSub:
+      movq(scratch, rax);
+      subq(scratch, rbx);
+      jmp(kOverflow, &heap_values);
+      orqb(scratch, Immediate(1));
+      break;
+     case BinOp::kMul:
+      {
+        Label no_overflow(this);
 
-    bind(&rhs_to_heap);
+        // (a << 1) * b
+        movq(scratch, rbx);
+        Untag(scratch);
+        subq(rax, Immediate(1));
+        imulq(scratch, rax);
+        jmp(kNoOverflow, &no_overflow);
 
-    // Check if rhs was unboxed after all
-    // i.e. we may came from this case: 1 + 3.5
-    IsUnboxed(rbx, &not_unboxed, NULL);
+        orqb(rax, Immediate(1));
+        jmp(&heap_values);
 
-    Pop(rbx);
+        bind(&no_overflow);
+        orqb(rax, Immediate(1));
+        orqb(scratch, Immediate(1));
+      }
+      break;
+     case BinOp::kDiv:
+     case BinOp::kMod:
+      // Division by zero produces infinity or NaN
+      cmpq(rbx, Immediate(TagNumber(0)));
+      jmp(kEq, &heap_values);
+
+      // No calls here, so stack alignment doesn't matter
+      push(rax);
+      push(rdx);
+
+      movq(scratch, rbx);
+      Untag(scratch);
+      Untag(rax);
+      cqo();
+      idivq(scratch);
+
+      if (op->subtype() == BinOp::kMod) {
+        // Remainder has dividend's sign and is less than divisor by magnitude
+        movq(scratch, rdx);
+        TagNumber(scratch);
+
+        pop(rdx);
+        pop(rax);
+      } else {
+        // Only (-2^62 / -1) doesn't fit into unboxed number
+        movq(scratch, rax);
+        addq(scratch, scratch);
+
+        // Popping doesn't affect flags
+        pop(rdx);
+        pop(rax);
+        jmp(kOverflow, &heap_values);
+        orqb(scratch, Immediate(1));
+      }
+      break;
+     default:
+      emitb(0xcc);
+      break;
+    }
+  }
 
-    Untag(rbx);
+  bind(&unboxed_result);
+  movq(rax, scratch);
+  xorq(scratch, scratch);
+  jmp(&done);
 
-    // Translate rhs to heap number
-    xorqd(xmm1, xmm1);
-    cvtsi2sd(xmm1, rbx);
+  bind(&heap_values);
 
-    AllocateNumber(xmm1, rbx);
+  if (op->is_math()) {
+    // Mixed and heap numbers are computed inline
+    LoadNumber(rax, xmm1, &call_stub);
+    LoadNumber(rbx, xmm2, &call_stub);
+    RecordFeedback(site, FeedbackSite::kDouble);
 
-    // Replace on-stack value of rbx
-    Push(rbx);
+    switch (op->subtype()) {
+     case BinOp::kAdd: addqd(xmm1, xmm2); break;
+     case BinOp::kSub: subqd(xmm1, xmm2); break;
+     case BinOp::kMul: mulqd(xmm1, xmm2); break;
+     case BinOp::kDiv: divqd(xmm1, xmm2); break;
+     default: break;
+    }
 
-    bind(&not_unboxed);
+    if (box != -1) {
+      Operand qvalue(rax, 8);
+      movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->double_box(box))));
+      movqd(qvalue, xmm1);
+    } else if (stack_box != -1) {
+      Label allocate(this);
+
+      // Update heap number owned by slot in place
+      Operand current(rbp, -8 * (stack_box + 1));
+      movq(rax, current);
+      IsNil(rax, NULL, &allocate);
+      IsUnboxed(rax, NULL, &allocate);
+      IsHeapObject(Heap::kTagNumber, rax, &allocate, NULL);
+
+      Operand qvalue(rax, 8);
+      movqd(qvalue, xmm1);
+      jmp(&done);
 
-    BaseStub* stub = NULL;
-    switch (op->subtype()) {
-     case BinOp::kAdd: stub = stubs()->GetBinaryAddStub(); break;
-     case BinOp::kSub: stub = stubs()->GetBinarySubStub(); break;
-     case BinOp::kMul: stub = stubs()->GetBinaryMulStub(); break;
-     case BinOp::kDiv: stub = stubs()->GetBinaryDivStub(); break;
-     default: emitb(0xcc); break;
+      bind(&allocate);
+      AllocateNumber(xmm1, rax);
+    } else {
+      AllocateNumber(xmm1, rax);
     }
+    jmp(&done);
+  }
 
-    // rax and rbx are already on stack
-    // so just call stub
-    if (stub != NULL) Call(stub);
+  bind(&call_stub);
+  RecordFeedback(site, FeedbackSite::kGeneric);
+
+  BaseStub* stub = NULL;
+  switch (op->subtype()) {
+   case BinOp::kAdd: stub = stubs()->GetBinaryAddStub(); break;
+   case BinOp::kSub: stub = stubs()->GetBinarySubStub(); break;
+   case BinOp::kMul: stub = stubs()->GetBinaryMulStub(); break;
+   case BinOp::kDiv: stub = stubs()->GetBinaryDivStub(); break;
+   case BinOp::kMod: stub = stubs()->GetBinaryModStub(); break;
+   case BinOp::kBAnd: stub = stubs()->GetBinaryBAndStub(); break;
+   case BinOp::kBOr: stub = stubs()->GetBinaryBOrStub(); break;
+   case BinOp::kBXor: stub = stubs()->GetBinaryBXorStub(); break;
+   case BinOp::kShl: stub = stubs()->GetBinaryShlStub(); break;
+   case BinOp::kShr: stub = stubs()->GetBinaryShrStub(); break;
+   case BinOp::kUShr: stub = stubs()->GetBinaryUShrStub(); break;
+   default: break;
+  }
 
-    bind(&done);
+  {
+    // Stub(lhs, rhs)
+    ChangeAlign(2);
+    Align a(this);
 
-    // Unwind stored rax and rbx
-    addq(rsp, 16);
+    push(rax);
+    push(rbx);
+    Call(stub);
+
+    // Caller should unwind stack
+    addq(rsp, Immediate(16));
     ChangeAlign(-2);
   }
 
+  bind(&done);
+
   Result(rax);
   Restore(rbx);
   Restore(rax);
@@ -0,0 +1,1096 @@
+#include "lir.h"
+#include "hir.h" // HIRGen, HIRInstruction, HIRBlock
+#include "macroassembler-x64.h" // Masm
+#include "feedback.h" // FeedbackSite
+#include "heap.h" // Heap, HString
+#include "stubs.h" // Stubs
+#include "zone.h" // Zone
+#include "utils.h" // List, RoundUp, PowerOfTwo
+
+#include <assert.h> // assert
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // NULL
+
+namespace candor {
+
+// rax, rcx, rdx and scratch are temporaries of instructions,
+// rbp, rsp and root register are reserved
+static const Register kRegisters[LGen::kRegisterCount] = {
+  rbx, rsi, rdi, r8, r9, r12, r13, r14, r15
+};
+
+
+// Pushad() doesn't save these, so GC can't update them
+static inline bool IsHiddenFromGC(Register reg) {
+  return reg.is(rbx) || reg.is(r13) || reg.is(r14);
+}
+
+
+LGen::LGen(Heap* heap,
+           HIRGen* hir,
+           LAllocator* allocator,
+           FeedbackVector* vector)
+    : Masm(heap),
+      hir_(hir),
+      allocator_(allocator),
+      vector_(vector),
+      spill_base_(hir->fn()->stack_slots() + kSavedSlots) {
+  stubs()->fns(&fns_);
+  labels_.allocated = true;
+
+  blocks_ = Zone::NewArray<Label*>(hir->block_count());
+  for (int32_t i = 0; i < hir->block_count(); i++) blocks_[i] = NewLabel();
+}
+
+
+LGen::~LGen() {
+}
+
+
+Label* LGen::NewLabel() {
+  Label* label = new Label(this);
+  labels_.Push(label);
+  return label;
+}
+
+
+Label* LGen::BlockLabel(HIRBlock* block) {
+  return blocks_[block->rpo()];
+}
+
+
+void LGen::Generate() {
+  if (hir_->osr() == NULL) {
+    GeneratePrologue();
+  } else {
+    GenerateOsrPrologue();
+  }
+
+  for (int32_t i = 0; i < hir_->block_count(); i++) {
+    HIRBlock* block = hir_->blocks()[i];
+    HIRBlock* next = i + 1 < hir_->block_count() ? hir_->blocks()[i + 1] :
+                                                    NULL;
+    bind(BlockLabel(block));
+
+    HIRInstructionList::Item* item = block->instructions()->head();
+    for (; item != NULL; item = item->next()) {
+      VisitInstruction(item->value(), next);
+    }
+  }
+
+  // Slow paths may queue more deferred code
+  LDeferred* deferred;
+  while ((deferred = deferred_.Shift()) != NULL) GenerateDeferred(deferred);
+
+  // Stubs are private to optimized code
+  FFunction* fn;
+  while ((fn = fns_.Shift()) != NULL) {
+    AlignCode();
+    fn->Allocate(offset());
+    fn->Generate();
+  }
+}
+
+
+void LGen::GeneratePrologue() {
+  // Frame has the same layout as fullgen's one:
+  // rsi <- tagged arguments count
+  // rdx, rcx, r8, r9 <- first arguments (fullgen's entry passes nil for
+  // missing ones)
+  push(rbp);
+  push(rbx);
+  movq(rbp, rsp);
+
+  uint32_t on_stack_size = 8 + RoundUp(
+      (spill_base_ + allocator_->spill_count() + 1) * 8, 16);
+  subq(rsp, Immediate(on_stack_size));
+  FillStackSlots(on_stack_size >> 3);
+  LoadDisplay(hir_->fn());
+
+  // Deoptimization may restart function
+  Operand context(rbp, SavedSlotOffset(kContextSlot));
+  Operand argc(rbp, SavedSlotOffset(kArgcSlot));
+  movq(context, rdi);
+  movq(argc, rsi);
+
+  uint32_t args = hir_->fn()->args()->length();
+  for (uint32_t i = 0; i < args && i < kArgRegisterCount; i++) {
+    Operand saved(rbp, SavedSlotOffset(kArgumentSlot + i));
+    movq(saved, ArgRegister(i));
+  }
+
+  // Caller's values in these registers may be stale (see SaveLive)
+  xorq(rbx, rbx);
+  xorq(r13, r13);
+  xorq(r14, r14);
+
+  // Load arguments (in the same order as fullgen does)
+  movq(rax, rsi);
+  HIRInstructionList::Item* item = hir_->blocks()[0]->instructions()->head();
+  for (; item != NULL; item = item->next()) {
+    HIRInstruction* param = item->value();
+    if (!param->is(HIRInstruction::kParameter)) continue;
+
+    // Argument registers may be allocated to parameters, so registers are
+    // loaded from their copies
+    int32_t index = param->index();
+    if (index < static_cast<int32_t>(kArgRegisterCount)) {
+      Operand saved(rbp, SavedSlotOffset(kArgumentSlot + index));
+      movq(scratch, saved);
+      Store(scratch, param);
+      continue;
+    }
+
+    Label skip(this);
+    Operand arg(rbp, 24 + 8 * (index - kArgRegisterCount));
+
+    movq(scratch, Immediate(Heap::kTagNil));
+    cmpq(rax, Immediate(TagNumber(index + 1)));
+    jmp(kLt, &skip);
+    movq(scratch, arg);
+    bind(&skip);
+
+    Store(scratch, param);
+  }
+
+  xorq(rax, rax);
+  xorq(scratch, scratch);
+}
+
+
+void LGen::GenerateOsrPrologue() {
+  uint32_t on_stack_size = 8 + RoundUp(
+      (spill_base_ + allocator_->spill_count() + 1) * 8, 16);
+  movq(rsp, rbp);
+  subq(rsp, Immediate(on_stack_size));
+
+  // Fill spill slots, but keep variables
+  movq(scratch, Immediate(Heap::kTagNil));
+  for (uint32_t i = hir_->fn()->stack_slots(); i < on_stack_size >> 3; i++) {
+    Operand slot(rbp, -8 * (i + 1));
+    movq(slot, scratch);
+  }
+
+  // Deoptimization will continue in the same loop
+  Operand context(rbp, SavedSlotOffset(kContextSlot));
+  movq(context, rdi);
+
+  // Fullgen's values in these registers are gone
+  xorq(rbx, rbx);
+  xorq(r13, r13);
+  xorq(r14, r14);
+
+  // Move variables into their locations, spill slots don't overlap them
+  HIRInstructionList::Item* item = hir_->blocks()[0]->instructions()->head();
+  for (; item != NULL; item = item->next()) {
+    HIRInstruction* value = item->value();
+    if (!value->is(HIRInstruction::kOsrValue)) continue;
+
+    Operand slot(rbp, -8 * (value->index() + 1));
+    movq(scratch, slot);
+    Store(scratch, value);
+  }
+
+  xorq(rax, rax);
+  xorq(scratch, scratch);
+}
+
+
+void LGen::GenerateEpilogue() {
+  // Temporaries may hold untagged values
+  xorq(rcx, rcx);
+  xorq(rdx, rdx);
+
+  movq(rsp, rbp);
+
+  // Replaced root frame restores callee-save registers
+  if (hir_->fn()->is_root()) {
+    pop(r15);
+    pop(r14);
+    pop(r13);
+    pop(r12);
+  }
+  pop(rbx);
+  pop(rbp);
+  ret(0);
+}
+
+
+Register LGen::RegisterOf(LInterval* interval) {
+  return kRegisters[interval->reg()];
+}
+
+
+void LGen::Load(HIRInstruction* value, Register dst) {
+  if (value->is(HIRInstruction::kConstant)) {
+    movq(dst, Immediate(reinterpret_cast<uint64_t>(value->value())));
+    return;
+  }
+
+  LInterval* interval = value->interval();
+  if (interval->is_register()) {
+    if (!RegisterOf(interval).is(dst)) movq(dst, RegisterOf(interval));
+  } else {
+    Operand slot(rbp, -8 * (spill_base_ + interval->spill() + 1));
+    movq(dst, slot);
+  }
+}
+
+
+void LGen::Store(Register src, HIRInstruction* value) {
+  LInterval* interval = value->interval();
+  if (interval == NULL) return;
+
+  if (interval->is_register()) {
+    if (!RegisterOf(interval).is(src)) movq(RegisterOf(interval), src);
+  } else {
+    Operand slot(rbp, -8 * (spill_base_ + interval->spill() + 1));
+    movq(slot, src);
+  }
+}
+
+
+void LGen::SaveLive(int32_t pos) {
+  LIntervalList::Item* item = allocator_->intervals()->head();
+  for (; item != NULL; item = item->next()) {
+    LInterval* interval = item->value();
+    if (interval->is_register() && interval->is_live(pos)) {
+      Push(RegisterOf(interval));
+    }
+  }
+
+  // Dead values in registers that GC doesn't see become stale after
+  // collection, nothing should push them later
+  for (int32_t i = 0; i < kRegisterCount; i++) {
+    if (!IsHiddenFromGC(kRegisters[i])) continue;
+
+    bool live = false;
+    for (item = allocator_->intervals()->head();
+         !live && item != NULL;
+         item = item->next()) {
+      live = item->value()->reg() == i && item->value()->is_live(pos);
+    }
+    if (!live) xorq(kRegisters[i], kRegisters[i]);
+  }
+}
+
+
+void LGen::RestoreLive(int32_t pos) {
+  LIntervalList::Item* item = allocator_->intervals()->tail();
+  for (; item != NULL; item = item->prev()) {
+    LInterval* interval = item->value();
+    if (interval->is_register() && interval->is_live(pos)) {
+      Pop(RegisterOf(interval));
+    }
+  }
+}
+
+
+void LGen::CallBinOpStub(BinOp::BinOpType type, int32_t pos) {
+  BaseStub* stub = NULL;
+  switch (type) {
+   case BinOp::kAdd: stub = stubs()->GetBinaryAddStub(); break;
+   case BinOp::kSub: stub = stubs()->GetBinarySubStub(); break;
+   case BinOp::kMul: stub = stubs()->GetBinaryMulStub(); break;
+   case BinOp::kDiv: stub = stubs()->GetBinaryDivStub(); break;
+   case BinOp::kMod: stub = stubs()->GetBinaryModStub(); break;
+   case BinOp::kBAnd: stub = stubs()->GetBinaryBAndStub(); break;
+   case BinOp::kBOr: stub = stubs()->GetBinaryBOrStub(); break;
+   case BinOp::kBXor: stub = stubs()->GetBinaryBXorStub(); break;
+   case BinOp::kShl: stub = stubs()->GetBinaryShlStub(); break;
+   case BinOp::kShr: stub = stubs()->GetBinaryShrStub(); break;
+   case BinOp::kUShr: stub = stubs()->GetBinaryUShrStub(); break;
+   case BinOp::kEq: stub = stubs()->GetBinaryEqStub(); break;
+   case BinOp::kStrictEq: stub = stubs()->GetBinaryStrictEqStub(); break;
+   case BinOp::kNe: stub = stubs()->GetBinaryNeStub(); break;
+   case BinOp::kStrictNe: stub = stubs()->GetBinaryStrictNeStub(); break;
+   case BinOp::kLt: stub = stubs()->GetBinaryLtStub(); break;
+   case BinOp::kGt: stub = stubs()->GetBinaryGtStub(); break;
+   case BinOp::kLe: stub = stubs()->GetBinaryLeStub(); break;
+   case BinOp::kGe: stub = stubs()->GetBinaryGeStub(); break;
+   default: assert(0 && "Unexpected"); return;
+  }
+
+  SaveLive(pos);
+  {
+    // Stub(lhs, rhs)
+    ChangeAlign(2);
+    Align a(this);
+
+    push(rax);
+    push(rcx);
+    xorq(rcx, rcx);
+    xorq(rdx, rdx);
+    Call(stub);
+
+    // Caller should unwind stack
+    addq(rsp, Immediate(16));
+    ChangeAlign(-2);
+  }
+  RestoreLive(pos);
+}
+
+
+void LGen::VisitInstruction(HIRInstruction* instr, HIRBlock* next) {
+  switch (instr->type()) {
+   case HIRInstruction::kBinOp:
+    VisitBinOp(instr, NULL, NULL);
+    break;
+   case HIRInstruction::kNot:
+    VisitNot(instr);
+    break;
+   case HIRInstruction::kLoadContext:
+    VisitLoadContext(instr);
+    break;
+   case HIRInstruction::kCheckTarget:
+    VisitCheckTarget(instr);
+    break;
+   case HIRInstruction::kGoto:
+    VisitGoto(instr, next);
+    break;
+   case HIRInstruction::kBranch:
+    VisitBranch(instr, next);
+    break;
+   case HIRInstruction::kReturn:
+    VisitReturn(instr);
+    break;
+   default:
+    // Incoming values are loaded by prologue, constants are rematerialized,
+    // and phis are written by predecessors
+    break;
+  }
+}
+
+
+// Returns true if compare can be fused with the branch that follows it
+static bool IsFusedCompare(HIRInstruction* instr) {
+  if (!instr->is(HIRInstruction::kBinOp) ||
+      !BinOp::is_compare(instr->subtype()) ||
+      instr->uses()->length() != 1) {
+    return false;
+  }
+
+  HIRInstruction* use = instr->uses()->head()->value();
+  HIRInstructionList::Item* last = instr->block()->instructions()->tail();
+
+  return use->is(HIRInstruction::kBranch) &&
+         last->value() == use &&
+         last->prev()->value() == instr;
+}
+
+
+static Condition CompareCondition(BinOp::BinOpType type) {
+  switch (type) {
+   case BinOp::kEq:
+   case BinOp::kStrictEq:
+    return kEq;
+   case BinOp::kNe:
+   case BinOp::kStrictNe:
+    return kNe;
+   case BinOp::kLt: return kLt;
+   case BinOp::kGt: return kGt;
+   case BinOp::kLe: return kLe;
+   case BinOp::kGe: return kGe;
+   default: assert(0 && "Unexpected"); return kEq;
+  }
+}
+
+
+void LGen::VisitBinOp(HIRInstruction* instr, Label* is_true, Label* is_false) {
+  // Compare is emitted by branch
+  if (is_true == NULL && IsFusedCompare(instr)) return;
+
+  BinOp::BinOpType type = instr->subtype();
+  HIRInstruction* lhs = instr->lhs();
+  HIRInstruction* rhs = instr->rhs();
+
+  // Speculative instruction has no slow path
+  Label* slow;
+  Label* exit = NewLabel();
+  if (instr->is_speculative()) {
+    slow = DeoptLabel(instr->snapshot());
+  } else {
+    LDeferred* deferred = new LDeferred(LDeferred::kBinOp,
+                                        instr,
+                                        instr->pos());
+    deferred->entry_ = NewLabel();
+    deferred->exit_ = exit;
+    deferred->is_true_ = is_true;
+    deferred->is_false_ = is_false;
+    deferred_.Push(deferred);
+
+    slow = deferred->entry_;
+  }
+
+  // Slow path reloads operands, so they may be clobbered here
+  Load(lhs, rax);
+  Load(rhs, rcx);
+
+  if (BinOp::is_bitwise(type)) {
+    // Heap numbers are truncated inline, like in fullgen
+    LoadInteger(rax, rdx, slow);
+    LoadInteger(rcx, rcx, slow);
+
+    switch (type) {
+     case BinOp::kBAnd: andq(rdx, rcx); break;
+     case BinOp::kBOr: orq(rdx, rcx); break;
+     case BinOp::kBXor: xorq(rdx, rcx); break;
+     case BinOp::kShl: shll_cl(rdx); break;
+     case BinOp::kShr: sarl_cl(rdx); break;
+     case BinOp::kUShr: shrl_cl(rdx); break;
+     default: break;
+    }
+
+    if (type == BinOp::kUShr) {
+      movl(rdx, rdx);
+    } else {
+      movsxlq(rdx, rdx);
+    }
+    TagNumber(rdx);
+    movq(rax, rdx);
+    xorq(rcx, rcx);
+    xorq(rdx, rdx);
+
+    bind(exit);
+    Store(rax, instr);
+    return;
+  }
+
+  // Tag checks are needed only if types weren't inferred
+  if (!lhs->is_smi()) IsUnboxed(rax, slow, NULL);
+  if (!rhs->is_smi()) IsUnboxed(rcx, slow, NULL);
+
+  if (BinOp::is_compare(type)) {
+    // Tagging preserves order of unboxed numbers
+    Condition cond = CompareCondition(type);
+    cmpq(rax, rcx);
+
+    if (is_true != NULL) {
+      jmp(cond, is_true);
+      jmp(is_false);
+      return;
+    }
+
+    Label set_true(this);
+    jmp(cond, &set_true);
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+    jmp(exit);
+    bind(&set_true);
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+
+    bind(exit);
+    Store(rax, instr);
+    return;
+  }
+
+  // Operate on tagged values: (a << 1 | 1) and (b << 1 | 1)
+  switch (type) {
+   case BinOp::kAdd:
+    movq(scratch, rax);
+    subq(scratch, Immediate(1));
+    addq(scratch, rcx);
+    jmp(kOverflow, slow);
+    break;
+   case BinOp::kSub:
+    movq(scratch, rax);
+    subq(scratch, rcx);
+    jmp(kOverflow, slow);
+    orqb(scratch, Immediate(1));
+    break;
+   case BinOp::kMul:
+    // (a << 1) * b
+    movq(scratch, rcx);
+    Untag(scratch);
+    movq(rdx, rax);
+    subq(rdx, Immediate(1));
+    imulq(scratch, rdx);
+    jmp(kOverflow, slow);
+    orqb(scratch, Immediate(1));
+    break;
+   case BinOp::kDiv:
+   case BinOp::kMod:
+    // Division by zero produces infinity or NaN
+    cmpq(rcx, Immediate(TagNumber(0)));
+    jmp(kEq, slow);
+
+    movq(scratch, rcx);
+    Untag(scratch);
+    Untag(rax);
+    cqo();
+    idivq(scratch);
+
+    if (type == BinOp::kMod) {
+      movq(scratch, rdx);
+      TagNumber(scratch);
+    } else {
+      // Only (-2^62 / -1) doesn't fit into unboxed number
+      movq(scratch, rax);
+      addq(scratch, scratch);
+      jmp(kOverflow, slow);
+      orqb(scratch, Immediate(1));
+    }
+    xorq(rdx, rdx);
+    break;
+   default:
+    emitb(0xcc);
+    break;
+  }
+
+  movq(rax, scratch);
+  xorq(scratch, scratch);
+
+  bind(exit);
+  Store(rax, instr);
+}
+
+
+void LGen::VisitNot(HIRInstruction* instr) {
+  Label* is_true = NewLabel();
+  Label* is_false = NewLabel();
+  Label done(this);
+
+  BranchOnValue(instr->lhs(), instr->pos(), is_true, is_false);
+
+  bind(is_false);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  jmp(&done);
+
+  bind(is_true);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+
+  bind(&done);
+  Store(rax, instr);
+}
+
+
+void LGen::VisitLoadContext(HIRInstruction* instr) {
+  // Optimized functions don't have context slots, so neither fullgen nor
+  // optimized code allocate contexts for them
+  int32_t display = hir_->fn()->DisplaySlot(instr->depth());
+  if (instr->depth() == -1) {
+    // Global variable's cell is in root context
+    movq(rax, root_reg);
+  } else if (display != -1) {
+    Operand cached(rbp, -8 * (display + 1));
+    movq(rax, cached);
+  } else {
+    Operand context(rbp, SavedSlotOffset(kContextSlot));
+    Operand parent(rax, 8);
+    movq(rax, context);
+
+    for (int32_t i = 0; i < instr->depth(); i++) movq(rax, parent);
+  }
+
+  Operand slot(rax, 8 * (instr->index() + 3));
+  movq(rax, slot);
+  Store(rax, instr);
+}
+
+
+void LGen::VisitCheckTarget(HIRInstruction* instr) {
+  Label* deopt = DeoptLabel(instr->snapshot());
+
+  Load(instr->lhs(), rax);
+  IsNil(rax, NULL, deopt);
+  IsUnboxed(rax, NULL, deopt);
+  IsHeapObject(Heap::kTagFunction, rax, deopt, NULL);
+
+  // Function objects of the same code may have different contexts,
+  // but inlined code doesn't use them
+  Operand code(rax, 16);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(instr->value())));
+  cmpq(scratch, code);
+  jmp(kNe, deopt);
+
+  xorq(scratch, scratch);
+}
+
+
+void LGen::BranchOnValue(HIRInstruction* value,
+                         int32_t pos,
+                         Label* is_true,
+                         Label* is_false) {
+  Load(value, rax);
+
+  // Booleans are singletons, so just compare addresses
+  if (value->types() == FeedbackSite::kBoolean) {
+    IsTrue(rax, is_false, is_true);
+    return;
+  }
+
+  Label heap_value(this);
+
+  // nil is falsy
+  IsNil(rax, NULL, is_false);
+
+  // Unboxed numbers are truthy unless zero
+  IsUnboxed(rax, &heap_value, NULL);
+  cmpq(rax, Immediate(TagNumber(0)));
+  jmp(kEq, is_false);
+  jmp(is_true);
+
+  bind(&heap_value);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  cmpq(rax, scratch);
+  jmp(kEq, is_true);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+  cmpq(rax, scratch);
+  jmp(kEq, is_false);
+
+  // Strings, heap numbers and objects are coerced in runtime
+  LDeferred* deferred = new LDeferred(LDeferred::kCoerce, value, pos);
+  deferred->entry_ = NewLabel();
+  deferred->is_true_ = is_true;
+  deferred->is_false_ = is_false;
+  deferred_.Push(deferred);
+
+  jmp(deferred->entry_);
+}
+
+
+void LGen::VisitGoto(HIRInstruction* instr, HIRBlock* next) {
+  HIRBlock* target = instr->block()->successor(0);
+
+  MovePhis(instr->block(), target);
+  if (target != next) jmp(BlockLabel(target));
+}
+
+
+void LGen::VisitBranch(HIRInstruction* instr, HIRBlock* next) {
+  HIRBlock* block = instr->block();
+
+  // Successors of branch have no phis (critical edges were split),
+  // so it may jump right into them
+  Label* is_true = BlockLabel(block->successor(0));
+  Label* is_false = BlockLabel(block->successor(1));
+
+  if (IsFusedCompare(instr->lhs())) {
+    VisitBinOp(instr->lhs(), is_true, is_false);
+  } else {
+    BranchOnValue(instr->lhs(), instr->pos(), is_true, is_false);
+  }
+}
+
+
+void LGen::VisitReturn(HIRInstruction* instr) {
+  Load(instr->lhs(), rax);
+  GenerateEpilogue();
+}
+
+
+// Location of value: register, stack slot or constant
+struct LMove {
+  HIRInstruction* src;
+  HIRInstruction* dst;
+  bool done;
+};
+
+
+static bool SameLocation(HIRInstruction* a, HIRInstruction* b) {
+  if (a->is(HIRInstruction::kConstant) || b->is(HIRInstruction::kConstant)) {
+    return false;
+  }
+
+  LInterval* x = a->interval();
+  LInterval* y = b->interval();
+  if (x->is_register()) return y->is_register() && x->reg() == y->reg();
+  return !y->is_register() && x->spill() == y->spill();
+}
+
+
+void LGen::MovePhis(HIRBlock* from, HIRBlock* to) {
+  int32_t count = to->phis()->length();
+  if (count == 0) return;
+
+  int32_t index = to->PredecessorIndex(from);
+  LMove* moves = Zone::NewArray<LMove>(count);
+
+  int32_t left = count;
+  HIRInstructionList::Item* item = to->phis()->head();
+  for (int32_t i = 0; item != NULL; item = item->next(), i++) {
+    HIRInstructionList::Item* input = item->value()->inputs()->head();
+    for (int32_t j = 0; j < index; j++) input = input->next();
+
+    moves[i].src = input->value();
+    moves[i].dst = item->value();
+    moves[i].done = SameLocation(moves[i].src, moves[i].dst);
+    if (moves[i].done) left--;
+  }
+
+  // rdx holds value of move that was removed from cycle
+  HIRInstruction* cycle = NULL;
+
+  while (left > 0) {
+    bool progress = false;
+
+    for (int32_t i = 0; i < count; i++) {
+      if (moves[i].done) continue;
+
+      // Move is blocked if it's destination is still to be read
+      bool blocked = false;
+      for (int32_t j = 0; !blocked && j < count; j++) {
+        blocked = j != i &&
+                  !moves[j].done &&
+                  moves[j].src != cycle &&
+                  SameLocation(moves[j].src, moves[i].dst);
+      }
+      if (blocked) continue;
+
+      if (moves[i].src == cycle) {
+        Store(rdx, moves[i].dst);
+      } else {
+        Load(moves[i].src, rax);
+        Store(rax, moves[i].dst);
+      }
+      moves[i].done = true;
+      progress = true;
+      left--;
+    }
+
+    if (progress || left == 0) continue;
+
+    // All remaining moves form cycles: break one of them by reading
+    // it's source into rdx
+    for (int32_t i = 0; i < count; i++) {
+      if (moves[i].done) continue;
+
+      Load(moves[i].src, rdx);
+      cycle = moves[i].src;
+      break;
+    }
+  }
+
+  xorq(rdx, rdx);
+}
+
+
+void LGen::GenerateDeferred(LDeferred* deferred) {
+  HIRInstruction* instr = deferred->instr();
+  int32_t pos = deferred->pos();
+
+  bind(deferred->entry_);
+
+  if (deferred->kind() == LDeferred::kDeopt) {
+    GenerateDeopt(instr);
+    return;
+  }
+
+  if (deferred->kind() == LDeferred::kCoerce) {
+    SaveLive(pos);
+    {
+      // Stub(value)
+      ChangeAlign(1);
+      Align a(this);
+
+      push(rax);
+      xorq(rcx, rcx);
+      xorq(rdx, rdx);
+      Call(stubs()->GetCoerceToBooleanStub());
+      // Stub will unwind stack automatically
+      ChangeAlign(-1);
+    }
+    RestoreLive(pos);
+
+    IsTrue(rax, deferred->is_false_, deferred->is_true_);
+    return;
+  }
+
+  BinOp::BinOpType type = instr->subtype();
+  Label call_stub(this), set_true(this), set_false(this), boolean(this);
+
+  Load(instr->lhs(), rax);
+  Load(instr->rhs(), rcx);
+
+  if (BinOp::is_math(type)) {
+    // Mixed and heap numbers are computed inline
+    LoadNumber(rax, xmm1, &call_stub);
+    LoadNumber(rcx, xmm2, &call_stub);
+
+    switch (type) {
+     case BinOp::kAdd: addqd(xmm1, xmm2); break;
+     case BinOp::kSub: subqd(xmm1, xmm2); break;
+     case BinOp::kMul: mulqd(xmm1, xmm2); break;
+     case BinOp::kDiv: divqd(xmm1, xmm2); break;
+     default: break;
+    }
+
+    SaveLive(pos);
+    xorq(rcx, rcx);
+    xorq(rdx, rdx);
+    AllocateNumber(xmm1, rax);
+    RestoreLive(pos);
+    jmp(deferred->exit_);
+  } else if (BinOp::is_compare(type)) {
+    LoadNumber(rax, xmm1, &call_stub);
+    LoadNumber(rcx, xmm2, &call_stub);
+
+    // ucomisd sets flags as an unsigned comparison does,
+    // unordered operands (NaN) set all of ZF, PF and CF
+    switch (CompareCondition(type)) {
+     case kLt:
+      ucomisd(xmm2, xmm1);
+      jmp(kAbove, &set_true);
+      break;
+     case kLe:
+      ucomisd(xmm2, xmm1);
+      jmp(kAboveEq, &set_true);
+      break;
+     case kGt:
+      ucomisd(xmm1, xmm2);
+      jmp(kAbove, &set_true);
+      break;
+     case kGe:
+      ucomisd(xmm1, xmm2);
+      jmp(kAboveEq, &set_true);
+      break;
+     case kEq:
+      ucomisd(xmm1, xmm2);
+      jmp(kParity, &set_false);
+      jmp(kEq, &set_true);
+      break;
+     case kNe:
+      ucomisd(xmm1, xmm2);
+      jmp(kParity, &set_true);
+      jmp(kNe, &set_true);
+      break;
+     default:
+      break;
+    }
+    jmp(&set_false);
+  }
+
+  bind(&call_stub);
+  CallBinOpStub(type, pos);
+  if (!BinOp::is_compare(type)) {
+    jmp(deferred->exit_);
+    return;
+  }
+  jmp(&boolean);
+
+  bind(&set_true);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  jmp(&boolean);
+
+  bind(&set_false);
+  movq(rax, Immediate(reinterpret_cast<uint64_t>(heap()->false_value())));
+
+  bind(&boolean);
+  if (deferred->is_true_ == NULL) {
+    jmp(deferred->exit_);
+  } else {
+    IsTrue(rax, deferred->is_false_, deferred->is_true_);
+  }
+}
+
+Label* LGen::DeoptLabel(HIRInstruction* snapshot) {
+  List<LDeferred*, ZoneObject>::Item* item = deferred_.head();
+  for (; item != NULL; item = item->next()) {
+    LDeferred* deferred = item->value();
+    if (deferred->kind() == LDeferred::kDeopt &&
+        deferred->instr() == snapshot) {
+      return deferred->entry_;
+    }
+  }
+
+  // Locations of values don't change, so code can be shared
+  LDeferred* deferred = new LDeferred(LDeferred::kDeopt, snapshot, -1);
+  deferred->entry_ = NewLabel();
+  deferred_.Push(deferred);
+
+  return deferred->entry_;
+}
+
+
+// Returns index of the first slot of snapshot that has given value
+static int32_t FirstSlot(HIRInstruction* snapshot, HIRInstruction* value) {
+  int32_t slot = 0;
+  HIRInstructionList::Item* item = snapshot->inputs()->head();
+  for (; item->value() != value; item = item->next()) slot++;
+
+  return slot;
+}
+
+
+void LGen::GenerateDeopt(HIRInstruction* snapshot) {
+  // Values of properties of objects that weren't allocated are pushed,
+  // so GC will update them while objects are materialized
+  int32_t props = 0;
+  int32_t slot = 0;
+  HIRInstructionList::Item* item = snapshot->inputs()->head();
+  for (; item != NULL; item = item->next(), slot++) {
+    HIRInstruction* obj = item->value();
+    if (!obj->is(HIRInstruction::kAllocateObject) ||
+        FirstSlot(snapshot, obj) != slot) {
+      continue;
+    }
+
+    HIRInstructionList::Item* prop = obj->inputs()->head();
+    for (; prop != NULL; prop = prop->next(), props++) {
+      Load(prop->value(), scratch);
+      push(scratch);
+    }
+  }
+  ChangeAlign(props);
+
+  // Stack slots get values that variables had at restart point,
+  // spill slots are after them, so moves don't overlap
+  slot = 0;
+  for (item = snapshot->inputs()->head();
+       item != NULL;
+       item = item->next(), slot++) {
+    Operand dst(rbp, -8 * (slot + 1));
+    if (item->value()->is(HIRInstruction::kAllocateObject)) {
+      movq(scratch, Immediate(Heap::kTagNil));
+    } else {
+      Load(item->value(), scratch);
+    }
+    movq(dst, scratch);
+  }
+
+  // Values are on stack now, and registers may hold untagged temporaries
+  for (int32_t i = 0; i < kRegisterCount; i++) {
+    xorq(kRegisters[i], kRegisters[i]);
+  }
+  xorq(rax, rax);
+  xorq(rcx, rcx);
+  xorq(rdx, rdx);
+  xorq(scratch, scratch);
+
+  // Fullgen updates heap numbers of variables in place, but here they may
+  // be shared by variables or be constants
+  slot = 0;
+  for (item = snapshot->inputs()->head();
+       item != NULL;
+       item = item->next(), slot++) {
+    if ((item->value()->types() & FeedbackSite::kDouble) == 0) continue;
+
+    Operand dst(rbp, -8 * (slot + 1));
+    movq(rax, dst);
+    CloneNumber(rax);
+    movq(dst, rax);
+  }
+
+  // Materialize objects in the same way as fullgen does,
+  // properties were pushed in order
+  int32_t prop_index = 0;
+  slot = 0;
+  for (item = snapshot->inputs()->head();
+       item != NULL;
+       item = item->next(), slot++) {
+    HIRInstruction* obj = item->value();
+    if (!obj->is(HIRInstruction::kAllocateObject)) continue;
+
+    Operand dst(rbp, -8 * (slot + 1));
+    int32_t first = FirstSlot(snapshot, obj);
+    if (first != slot) {
+      Operand src(rbp, -8 * (first + 1));
+      movq(rax, src);
+      movq(dst, rax);
+      continue;
+    }
+
+    ObjectLiteral* literal = ObjectLiteral::Cast(obj->ast());
+    if (literal->keys()->length() <= kMaxBoilerplateKeys) {
+      uint32_t offsets[kMaxBoilerplateKeys];
+      bool is_inline = AllocateObjectLiteral(literal, offsets, rax);
+      movq(dst, rax);
+
+      // Nothing is allocated below, so map stays in place
+      if (!is_inline) {
+        Operand qmap(rax, 16);
+        movq(rax, qmap);
+      }
+      for (uint32_t i = 0; i < literal->keys()->length(); i++, prop_index++) {
+        Operand value(rsp, 8 * (props - prop_index - 1));
+        Operand property(rax, offsets[i]);
+        movq(scratch, value);
+        movq(property, scratch);
+      }
+      continue;
+    }
+
+    movq(rbx, Immediate(TagNumber(PowerOfTwo(literal->keys()->length() << 1))));
+    AllocateObjectLiteral(rbx, rax);
+    movq(dst, rax);
+    xorq(rbx, rbx);
+
+    AstList::Item* key = literal->keys()->head();
+    for (; key != NULL; key = key->next(), prop_index++) {
+      char* name = HString::NewSymbol(heap(),
+                                      key->value()->value(),
+                                      key->value()->length());
+      {
+        // Stub(change, property, object), object may have been moved by GC
+        ChangeAlign(3);
+        Align a(this);
+
+        movq(rax, dst);
+        push(rax);
+        movq(rax, Immediate(reinterpret_cast<uint64_t>(name)));
+        push(rax);
+        movq(rax, Immediate(1));
+        push(rax);
+        Call(stubs()->GetLookupPropertyStub());
+        // Stub will unwind stack automatically
+        ChangeAlign(-3);
+      }
+
+      Operand value(rsp, 8 * (props - prop_index - 1));
+      Operand property(rax, 0);
+      movq(scratch, value);
+      movq(property, scratch);
+    }
+  }
+  xorq(rax, rax);
+  xorq(scratch, scratch);
+
+  addq(rsp, Immediate(8 * props));
+  ChangeAlign(-props);
+
+  {
+    // Stub(vector)
+    ChangeAlign(1);
+    Align a(this);
+
+    movq(rax, Immediate(reinterpret_cast<uint64_t>(vector_)));
+    push(rax);
+    Call(stubs()->GetDeoptimizeStub());
+    // Stub will unwind stack automatically
+    ChangeAlign(-1);
+  }
+  xorq(rax, rax);
+
+  Operand context(rbp, SavedSlotOffset(kContextSlot));
+  Operand argc(rbp, SavedSlotOffset(kArgcSlot));
+  movq(rdi, context);
+
+  char* resume = vector_->ResumePoint(snapshot->ast());
+  assert(resume != NULL);
+
+  if (snapshot->ast() == hir_->fn()) {
+    // Function is called again with the same arguments
+    movq(rsi, argc);
+    uint32_t args = hir_->fn()->args()->length();
+    for (uint32_t i = 0; i < args && i < kArgRegisterCount; i++) {
+      Operand saved(rbp, SavedSlotOffset(kArgumentSlot + i));
+      movq(ArgRegister(i), saved);
+    }
+    movq(rsp, rbp);
+    pop(rbx);
+    pop(rbp);
+  } else {
+    // Loop's condition is evaluated in fullgen's frame
+    uint32_t on_stack_size = 8 + RoundUp((hir_->fn()->stack_slots() + 1) * 8,
+                                         16);
+    movq(rsp, rbp);
+    subq(rsp, Immediate(on_stack_size));
+
+    // Snapshot doesn't keep outer contexts
+    LoadDisplay(hir_->fn());
+  }
+
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(resume)));
+  jmp(scratch);
+}
+
+} // namespace candor
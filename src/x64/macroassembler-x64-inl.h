@@ -67,7 +67,7 @@ inline void Masm::TagNumber(Register src) {
 
 
 inline void Masm::Untag(Register src) {
-  shr(src, Immediate(1));
+  sar(src, Immediate(1));
 }
 
 } // namespace candor
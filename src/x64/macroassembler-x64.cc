@@ -3,6 +3,7 @@
 #include "stubs.h"
 #include "utils.h" // ComputeHash
 
+#include <assert.h> // assert
 #include <stdlib.h> // NULL
 
 namespace candor {
@@ -55,7 +56,9 @@ void Masm::AlignCode() {
 
 Masm::Align::Align(Masm* masm) : masm_(masm), align_(masm->align_) {
   if (align_ % 2 == 0) return;
-  masm_->subq(rsp, (align_ % 2) * 8);
+
+  // Padding is scanned by GC, so it shouldn't keep stale stack data
+  masm_->push(Immediate(Heap::kTagNil));
   masm->align_ += 1;
 }
 
@@ -152,19 +155,6 @@ void Masm::AllocateNumber(DoubleRegister value, Register result) {
 }
 
 
-void Masm::AllocateBoolean(Register value, Register result) {
-  // Value is often a scratch register, so store it before doing a stub call
-  PushTagged(value);
-
-  Allocate(Heap::kTagBoolean, reg_nil, 8, result);
-
-  PopTagged(value);
-
-  Operand qvalue(result, 8);
-  movb(qvalue, value);
-}
-
-
 void Masm::AllocateString(const char* value,
                           uint32_t length,
                           Register result) {
@@ -174,7 +164,7 @@ void Masm::AllocateString(const char* value,
   Operand qhash(result, 8);
   Operand qlength(result, 16);
 
-  movq(qhash, Immediate(ComputeHash(value, length)));
+  movq(qhash, Immediate(ComputeHash(value, length, heap()->hash_seed())));
   movq(qlength, Immediate(length));
 
   // Copy the value into (inlined)
@@ -204,10 +194,10 @@ void Masm::AllocateObjectLiteral(Register size, Register result) {
   // Set mask
   movq(scratch, size);
 
-  // mask (= (size - 1) << 3)
+  // mask (= (size - 1) << 4)
   Untag(scratch);
   dec(scratch);
-  shl(scratch, Immediate(3));
+  shl(scratch, Immediate(4));
   movq(qmask, scratch);
   xorq(scratch, scratch);
 
@@ -230,7 +220,7 @@ void Masm::AllocateObjectLiteral(Register size, Register result) {
   Push(result);
   movq(result, scratch);
 
-  // Save map size for GC
+  // Save map size for GC (count of keys is zero)
   Operand qmapsize(result, 8);
   Untag(size);
   movq(qmapsize, size);
@@ -245,6 +235,116 @@ void Masm::AllocateObjectLiteral(Register size, Register result) {
 }
 
 
+bool Masm::AllocateObjectLiteral(ObjectLiteral* literal,
+                                 uint32_t* offsets,
+                                 Register result) {
+  assert(literal->keys()->length() <= kMaxBoilerplateKeys);
+
+  // Intern keys and find duplicates
+  char* strkeys[kMaxBoilerplateKeys];
+  uint32_t count = 0;
+  AstList::Item* key = literal->keys()->head();
+  for (uint32_t i = 0; key != NULL; key = key->next(), i++) {
+    strkeys[i] = HString::NewSymbol(heap(),
+                                    key->value()->value(),
+                                    key->value()->length());
+    uint32_t j = 0;
+    while (j < i && strkeys[j] != strkeys[i]) j++;
+    if (j == i) count++;
+  }
+
+  if (count <= HObject::kInlineProperties) {
+    // Place keys one after another the same way as RuntimeLookupProperty
+    // does for small objects
+    char* keys[HObject::kInlineProperties];
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < literal->keys()->length(); i++) {
+      uint32_t j = 0;
+      while (j < index && keys[j] != strkeys[i]) j++;
+      if (j == index) keys[index++] = strkeys[i];
+      offsets[i] = 24 + (j << 4) + 8;
+    }
+
+    // mask + map + entries
+    Allocate(Heap::kTagObject,
+             reg_nil,
+             16 + (HObject::kInlineProperties << 4),
+             result);
+
+    Operand qmask(result, 8);
+    Operand qmap(result, 16);
+    movq(qmask, Immediate(0));
+    movq(qmap, Immediate(Heap::kTagNil));
+    for (uint32_t i = 0; i < HObject::kInlineProperties; i++) {
+      Operand qkey(result, 24 + (i << 4));
+      Operand qvalue(result, 32 + (i << 4));
+      if (i < count) {
+        movq(scratch, Immediate(reinterpret_cast<uint64_t>(keys[i])));
+        movq(qkey, scratch);
+      } else {
+        movq(qkey, Immediate(Heap::kTagNil));
+      }
+      movq(qvalue, Immediate(Heap::kTagNil));
+    }
+    xorq(scratch, scratch);
+
+    return true;
+  }
+
+  // Ensure that map will be filled only by half at maximum
+  uint32_t size = PowerOfTwo(literal->keys()->length() << 1);
+  uint32_t mask = (size - 1) << 4;
+
+  // Place keys the same way as RuntimeLookupProperty does,
+  // duplicates share one entry
+  char* keys[kMaxBoilerplateKeys << 1];
+  for (uint32_t i = 0; i < size; i++) keys[i] = NULL;
+
+  for (uint32_t i = 0; i < literal->keys()->length(); i++) {
+    uint32_t index = HString(strkeys[i]).hash() & mask;
+    while (keys[index >> 4] != NULL && keys[index >> 4] != strkeys[i]) {
+      index = (index + 16) & mask;
+    }
+    keys[index >> 4] = strkeys[i];
+    offsets[i] = 16 + index + 8;
+  }
+
+  // mask + map
+  Allocate(Heap::kTagObject, reg_nil, 16, result);
+
+  Operand qmask(result, 8);
+  Operand qmap(result, 16);
+  movq(qmask, Immediate(mask));
+
+  // size + count + entries
+  Allocate(Heap::kTagMap, reg_nil, 8 + (size << 4), scratch);
+  movq(qmap, scratch);
+
+  // Copy boilerplate into map, keys are immortal so they're
+  // embedded as immediates (result is a temporary here)
+  Push(result);
+  Operand qmapsize(scratch, 8);
+  Operand qmapcount(scratch, 12);
+  movl(qmapsize, Immediate(size));
+  movl(qmapcount, Immediate(count));
+  for (uint32_t i = 0; i < size; i++) {
+    Operand qkey(scratch, 16 + (i << 4));
+    Operand qvalue(scratch, 24 + (i << 4));
+    if (keys[i] != NULL) {
+      movq(result, Immediate(reinterpret_cast<uint64_t>(keys[i])));
+      movq(qkey, result);
+    } else {
+      movq(qkey, Immediate(Heap::kTagNil));
+    }
+    movq(qvalue, Immediate(Heap::kTagNil));
+  }
+  Pop(result);
+  xorq(scratch, scratch);
+
+  return false;
+}
+
+
 void Masm::Fill(Register start, Register end, Immediate value) {
   Push(start);
   movq(scratch, value);
@@ -281,6 +381,24 @@ void Masm::FillStackSlots(uint32_t slots) {
 }
 
 
+void Masm::LoadDisplay(FunctionLiteral* fn) {
+  if (fn->display()->length() == 0) return;
+
+  Operand parent(scratch, 8);
+  int32_t depth = 0;
+  movq(scratch, rdi);
+
+  List<ScopeSlot*, ZoneObject>::Item* item = fn->display()->head();
+  for (; item != NULL; item = item->next()) {
+    for (; depth < item->value()->depth(); depth++) movq(scratch, parent);
+
+    Operand slot(rbp, -8 * (fn->DisplaySlot(depth) + 1));
+    movq(slot, scratch);
+  }
+  xorq(scratch, scratch);
+}
+
+
 void Masm::IsNil(Register reference, Label* not_nil, Label* is_nil) {
   cmpq(reference, Immediate(Heap::kTagNil));
   if (is_nil != NULL) jmp(kEq, is_nil);
@@ -307,17 +425,145 @@ void Masm::IsHeapObject(Heap::HeapTag tag,
 
 
 void Masm::IsTrue(Register reference, Label* is_false, Label* is_true) {
-  // reference is definitely a boolean value
-  // so no need to check it's type here
-  Operand bvalue(reference, 8);
-  cmpb(bvalue, Immediate(0));
-  if (is_false != NULL) jmp(kEq, is_false);
-  if (is_true != NULL) jmp(kNe, is_true);
+  // reference is definitely a boolean value and there're only
+  // two boolean objects, so just compare addresses
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(heap()->true_value())));
+  cmpq(reference, scratch);
+  if (is_false != NULL) jmp(kNe, is_false);
+  if (is_true != NULL) jmp(kEq, is_true);
+}
+
+
+void Masm::LoadNumber(Register src, DoubleRegister dst, Label* not_number) {
+  Label unboxed(this), done(this);
+
+  IsNil(src, NULL, not_number);
+  IsUnboxed(src, NULL, &unboxed);
+  IsHeapObject(Heap::kTagNumber, src, not_number, NULL);
+
+  Operand value(src, 8);
+  movqd(dst, value);
+  jmp(&done);
+
+  bind(&unboxed);
+
+  // Keep `src` tagged, it may be still referenced
+  movq(scratch, src);
+  sar(scratch, Immediate(1));
+  cvtsi2sd(dst, scratch);
+
+  bind(&done);
 }
 
 
-void Masm::UnboxNumber(Register number) {
-  assert(0 && "Not implemented");
+void Masm::LoadInteger(Register src, Register dst, Label* slow) {
+  Label heap_number(this), done(this);
+
+  IsUnboxed(src, &heap_number, NULL);
+  movq(dst, src);
+  Untag(dst);
+  jmp(&done);
+
+  bind(&heap_number);
+  LoadNumber(src, xmm1, slow);
+  cvttsd2si(dst, xmm1);
+
+  // NaN, infinity and out of range values are converted to 0x8000...0
+  movq(scratch, Immediate(0x8000000000000000ULL));
+  cmpq(dst, scratch);
+  jmp(kEq, slow);
+
+  bind(&done);
+}
+
+
+void Masm::CloneNumber(Register value) {
+  Label done(this);
+
+  IsNil(value, NULL, &done);
+  IsUnboxed(value, NULL, &done);
+  IsHeapObject(Heap::kTagNumber, value, &done, NULL);
+
+  Operand qvalue(value, 8);
+  movqd(xmm1, qvalue);
+  AllocateNumber(xmm1, value);
+
+  bind(&done);
+}
+
+
+void Masm::RecordFeedback(FeedbackSite* site, uint8_t types) {
+  Operand types_op(scratch, 0);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->types_addr())));
+  orb(types_op, Immediate(types));
+}
+
+
+void Masm::RecordCallTarget(FeedbackSite* site,
+                            Register fn,
+                            Register tmp,
+                            uint32_t args) {
+  Label done(this), monomorphic(this), megamorphic(this);
+
+  Operand code_slot(fn, 16);
+  Operand target(scratch, 0);
+  Operand function(scratch, 0);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->target_addr())));
+  movq(tmp, code_slot);
+
+  // Same callee as before
+  cmpq(tmp, target);
+  jmp(kEq, &monomorphic);
+
+  cmpq(target, Immediate(0));
+  jmp(kNe, &megamorphic);
+  movq(target, tmp);
+
+  // Callee doesn't need to check arguments count if there're enough of them
+  Label patch(this);
+  Operand arity(tmp, kArityOffset);
+  cmpl(arity, Immediate(TagNumber(args)));
+  jmp(kGt, &patch);
+  addq(tmp, Immediate(kFastEntryOffset));
+  bind(&patch);
+  PatchCall(site, tmp);
+  jmp(&monomorphic);
+
+  bind(&megamorphic);
+  cmpq(target, Immediate(FeedbackSite::kMegamorphic));
+  jmp(kEq, &done);
+  movq(target, Immediate(FeedbackSite::kMegamorphic));
+
+  // Call through function object from now on
+  movq(tmp, Immediate(reinterpret_cast<uint64_t>(site->generic_addr())));
+  Operand generic(tmp, 0);
+  movq(tmp, generic);
+  PatchCall(site, tmp);
+
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->function_addr())));
+  movq(function, Immediate(FeedbackSite::kNoFunction));
+  jmp(&done);
+
+  // Next call of the same function won't be checked
+  bind(&monomorphic);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->function_addr())));
+  movq(function, fn);
+
+  bind(&done);
+
+  // Code address isn't a heap value, don't let GC see it
+  xorq(tmp, tmp);
+}
+
+
+void Masm::PatchCall(FeedbackSite* site, Register addr) {
+  // Displacement is relative to the end of instruction
+  Operand call(scratch, 0);
+  Operand displacement(scratch, -4);
+  movq(scratch, Immediate(reinterpret_cast<uint64_t>(site->call_addr())));
+  movq(scratch, call);
+  subq(addr, scratch);
+  movl(displacement, addr);
 }
 
 
@@ -353,13 +599,64 @@ void Masm::Call(Operand& addr) {
 }
 
 
-void Masm::Call(Register fn, uint32_t args) {
+void Masm::Call(FeedbackSite* site, Register fn, uint32_t args) {
+  Label generic(this), done(this);
+
+  Operand context_slot(fn, 8);
+  Operand code_slot(fn, 16);
+  movq(rdi, context_slot);
+  movq(rsi, Immediate(TagNumber(args)));
+
+  // Return address is odd (`call` is 5 bytes long) and points to nop,
+  // call goes through function object until RecordCallTarget patches it
+  while ((offset() & 0x1) != 0x0) {
+    nop();
+  }
+  callq(&generic);
+  uint32_t call = offset();
+  nop();
+  jmp(&done);
+
+  bind(&generic);
+  site->CallSite(call, offset());
+  movq(scratch, code_slot);
+  jmp(scratch);
+
+  bind(&done);
+}
+
+
+void Masm::TailCall(FeedbackSite* site, Register fn, uint32_t args) {
+  Label generic(this);
+
   Operand context_slot(fn, 8);
   Operand code_slot(fn, 16);
   movq(rdi, context_slot);
-  movq(rsi, Immediate(args));
+  movq(rsi, Immediate(TagNumber(args)));
+
+  // Same as epilogue, but callee will return
+  movq(rsp, rbp);
+  pop(rbx);
+  pop(rbp);
+
+  // `jmp` is patched in the same way as `call`
+  jmp(&generic);
+  site->CallSite(offset(), offset());
+
+  bind(&generic);
+  movq(scratch, code_slot);
+  jmp(scratch);
+}
+
+
+static const Register kArgRegisters[Masm::kArgRegisterCount] = {
+  rdx, rcx, r8, r9
+};
+
 
-  Call(code_slot);
+Register Masm::ArgRegister(uint32_t index) {
+  assert(index < kArgRegisterCount);
+  return kArgRegisters[index];
 }
 
 
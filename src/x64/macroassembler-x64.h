@@ -49,21 +49,34 @@ class Masm : public Assembler {
   // Allocate heap numbers
   void AllocateNumber(DoubleRegister value, Register result);
 
-  // Allocate boolean value, `value` should be either 0 or 1
-  void AllocateBoolean(Register value, Register result);
-
   // Allocate heap string (symbol)
   void AllocateString(const char* value, uint32_t length, Register result);
 
   // Allocate object&map
   void AllocateObjectLiteral(Register size, Register result);
 
+  // Allocate object with boilerplate map of literal's keys (their places
+  // are found at compile time), `offsets` receives offset of every value
+  // in the map. Values are nil until stored by caller.
+  // Returns true if keys were placed inline, and offsets are relative to
+  // the object itself
+  bool AllocateObjectLiteral(ObjectLiteral* literal,
+                             uint32_t* offsets,
+                             Register result);
+
+  // Literals with more keys fill their maps by lookups
+  static const uint32_t kMaxBoilerplateKeys = 16;
+
   // Fills memory segment with immediate value
   void Fill(Register start, Register end, Immediate value);
 
   // Fill stack slots with nil
   void FillStackSlots(uint32_t slots);
 
+  // Loads function's outer contexts (starting from rdi) into their stack
+  // slots (see FunctionLiteral::display())
+  void LoadDisplay(FunctionLiteral* fn);
+
   void IsNil(Register reference, Label* not_nil, Label* is_nil);
   void IsUnboxed(Register reference, Label* not_unboxed, Label* unboxed);
 
@@ -75,7 +88,26 @@ class Masm : public Assembler {
   void IsTrue(Register reference, Label* is_false, Label* is_true);
 
   // Unboxing routines
-  void UnboxNumber(Register number);
+  // Loads unboxed or heap number into `dst`, jumps to `not_number` otherwise
+  void LoadNumber(Register src, DoubleRegister dst, Label* not_number);
+  // Loads truncated integer value of unboxed or heap number into `dst`,
+  // jumps to `slow` if number isn't representable as int64 (or isn't number)
+  void LoadInteger(Register src, Register dst, Label* slow);
+
+  // Replaces heap number in `value` with it's fresh copy
+  void CloneNumber(Register value);
+
+  // Type feedback (see feedback.h), both clobber scratch and flags
+  void RecordFeedback(FeedbackSite* site, uint8_t types);
+  // Records code of function in `fn` as call target and patches site's
+  // direct call (passing `args` arguments), clobbers `tmp`
+  void RecordCallTarget(FeedbackSite* site,
+                        Register fn,
+                        Register tmp,
+                        uint32_t args);
+
+  // Points direct call of site to code address in `addr`, clobbers `addr`
+  void PatchCall(FeedbackSite* site, Register addr);
 
   // Store stack pointer into heap
   void StoreRootStack();
@@ -86,9 +118,25 @@ class Masm : public Assembler {
   // Sets correct environment and calls function
   void Call(Register addr);
   void Call(Operand& addr);
-  void Call(Register fn, uint32_t args);
   void Call(BaseStub* stub);
 
+  // Calls function in `fn` through call site (see RecordCallTarget),
+  // first arguments should be in ArgRegister()s and the rest on stack
+  void Call(FeedbackSite* site, Register fn, uint32_t args);
+
+  // Leaves current (non-root) frame and jumps into function in `fn`, so
+  // it returns directly to our caller. All arguments should be in registers
+  void TailCall(FeedbackSite* site, Register fn, uint32_t args);
+
+  // Calling convention: first arguments are passed in registers
+  static const uint32_t kArgRegisterCount = 4;
+  static Register ArgRegister(uint32_t index);
+
+  // Function's code starts with `cmpq rsi, <tagged arity>; jl <adaptor>`,
+  // calls with enough arguments may enter right after it
+  static const uint32_t kArityOffset = 3;
+  static const uint32_t kFastEntryOffset = 13;
+
   inline void Push(Register src);
   inline void Pop(Register src);
   inline void PushTagged(Register src);
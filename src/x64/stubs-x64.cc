@@ -29,8 +29,8 @@ void BaseStub::GenerateEpilogue(int args) {
 
 void AllocateStub::Generate() {
   GeneratePrologue();
-  // Align stack
-  __ subq(rsp, Immediate(8));
+  // Align stack (padding is scanned by GC, so it shouldn't keep stale data)
+  __ push(Immediate(Heap::kTagNil));
   __ push(rbx);
 
   // Arguments
@@ -111,9 +111,23 @@ void AllocateStub::Generate() {
     __ xorq(rdx, rdx);
 
     __ bind(&call);
+
+    // Fullgen keeps doubles in xmm1 and xmm2 while allocating heap numbers,
+    // store them below stack_top so GC won't treat them as pointers
+    Operand xmm1_slot(rsp, 0);
+    Operand xmm2_slot(rsp, 8);
+    __ subq(rsp, Immediate(16));
+    __ movqd(xmm1_slot, xmm1);
+    __ movqd(xmm2_slot, xmm2);
+
     __ movq(scratch, Immediate(*reinterpret_cast<uint64_t*>(&allocate)));
 
     __ callq(scratch);
+
+    __ movqd(xmm1, xmm1_slot);
+    __ movqd(xmm2, xmm2_slot);
+    __ addq(rsp, Immediate(16));
+
     __ Popad(rax);
   }
 
@@ -132,6 +146,68 @@ void AllocateStub::Generate() {
 }
 
 
+void OptimizeStub::Generate() {
+  GeneratePrologue();
+  RuntimeOptimizeCallback optimize = &RuntimeOptimize;
+
+  // Arguments
+  Operand vector(rbp, 16);
+
+  __ Pushad();
+
+  // RuntimeOptimize(heap, vector)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, vector);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&optimize)));
+  __ callq(rax);
+
+  __ Popad(rax);
+  GenerateEpilogue(1);
+}
+
+
+void OsrStub::Generate() {
+  GeneratePrologue();
+  RuntimeOsrCallback osr = &RuntimeOsr;
+
+  // Arguments
+  Operand vector(rbp, 24);
+  Operand loop(rbp, 16);
+
+  __ Pushad();
+
+  // RuntimeOsr(heap, vector, loop)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, vector);
+  __ movq(rdx, loop);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&osr)));
+  __ callq(rax);
+
+  __ Popad(rax);
+  GenerateEpilogue(2);
+}
+
+
+void DeoptimizeStub::Generate() {
+  GeneratePrologue();
+  RuntimeDeoptimizeCallback deoptimize = &RuntimeDeoptimize;
+
+  // Arguments
+  Operand vector(rbp, 16);
+
+  __ Pushad();
+
+  // RuntimeDeoptimize(heap, vector)
+  __ movq(rdi, Immediate(reinterpret_cast<uint64_t>(masm()->heap())));
+  __ movq(rsi, vector);
+  __ movq(rax, Immediate(*reinterpret_cast<uint64_t*>(&deoptimize)));
+  __ callq(rax);
+
+  __ Popad(reg_nil);
+  GenerateEpilogue(1);
+}
+
+
 void ThrowStub::Generate() {
   Immediate pending_exception(
       reinterpret_cast<uint64_t>(masm()->heap()->pending_exception()));
@@ -229,9 +305,84 @@ void BinaryDivStub::Generate() {
 }
 
 
+void BinaryModStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kMod))->Generate();
+}
+
+
+void BinaryBAndStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kBAnd))->Generate();
+}
+
+
+void BinaryBOrStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kBOr))->Generate();
+}
+
+
+void BinaryBXorStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kBXor))->Generate();
+}
+
+
+void BinaryShlStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kShl))->Generate();
+}
+
+
+void BinaryShrStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kShr))->Generate();
+}
+
+
+void BinaryUShrStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kUShr))->Generate();
+}
+
+
+void BinaryLtStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kLt))->Generate();
+}
+
+
+void BinaryGtStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kGt))->Generate();
+}
+
+
+void BinaryLeStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kLe))->Generate();
+}
+
+
+void BinaryGeStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kGe))->Generate();
+}
+
+
+void BinaryEqStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kEq))->Generate();
+}
+
+
+void BinaryStrictEqStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kStrictEq))->Generate();
+}
+
+
+void BinaryNeStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kNe))->Generate();
+}
+
+
+void BinaryStrictNeStub::Generate() {
+  (new BinaryOpStub(masm(), BinOp::kStrictNe))->Generate();
+}
+
+
 void BinaryOpStub::Generate() {
   GeneratePrologue();
-  __ subq(rsp, Immediate(8));
+  __ push(Immediate(Heap::kTagNil));
   __ push(rbx);
 
   // Arguments
@@ -243,9 +394,17 @@ void BinaryOpStub::Generate() {
   __ movq(rax, lhs);
   __ movq(rbx, rhs);
 
+  // Numbers are compared and truncated to integers inline, so only
+  // arithmetic stubs have fast path for heap numbers
+  if (!BinOp::is_math(type())) __ jmp(&call_runtime);
+
   __ IsNil(rax, NULL, &call_runtime);
   __ IsNil(rbx, NULL, &call_runtime);
 
+  // Fullgen passes small integers mixed with other values here
+  __ IsUnboxed(rax, NULL, &call_runtime);
+  __ IsUnboxed(rbx, NULL, &call_runtime);
+
   __ IsHeapObject(Heap::kTagNumber, rax, &call_runtime, NULL);
   __ IsHeapObject(Heap::kTagNumber, rbx, &call_runtime, NULL);
 
@@ -270,10 +429,28 @@ void BinaryOpStub::Generate() {
   __ jmp(&done);
   __ bind(&call_runtime);
 
-  RuntimeBinOpCallback cb;
+  RuntimeBinOpCallback cb = NULL;
 
   switch (type()) {
    case BinOp::kAdd: cb = &RuntimeBinOpAdd; break;
+   case BinOp::kSub: cb = &RuntimeBinOpSub; break;
+   case BinOp::kMul: cb = &RuntimeBinOpMul; break;
+   case BinOp::kDiv: cb = &RuntimeBinOpDiv; break;
+   case BinOp::kMod: cb = &RuntimeBinOpMod; break;
+   case BinOp::kBAnd: cb = &RuntimeBinOpBAnd; break;
+   case BinOp::kBOr: cb = &RuntimeBinOpBOr; break;
+   case BinOp::kBXor: cb = &RuntimeBinOpBXor; break;
+   case BinOp::kShl: cb = &RuntimeBinOpShl; break;
+   case BinOp::kShr: cb = &RuntimeBinOpShr; break;
+   case BinOp::kUShr: cb = &RuntimeBinOpUShr; break;
+   case BinOp::kLt: cb = &RuntimeBinOpLt; break;
+   case BinOp::kGt: cb = &RuntimeBinOpGt; break;
+   case BinOp::kLe: cb = &RuntimeBinOpLe; break;
+   case BinOp::kGe: cb = &RuntimeBinOpGe; break;
+   case BinOp::kEq: cb = &RuntimeBinOpEq; break;
+   case BinOp::kStrictEq: cb = &RuntimeBinOpStrictEq; break;
+   case BinOp::kNe: cb = &RuntimeBinOpNe; break;
+   case BinOp::kStrictNe: cb = &RuntimeBinOpStrictNe; break;
    default: __ emitb(0xcc); break;
   }
 
@@ -5,6 +5,7 @@
 #include <stdlib.h> // malloc, free, abort
 #include <sys/types.h> // size_t
 #include <assert.h> // assert
+#include <string.h> // memset
 
 namespace candor {
 
@@ -63,6 +64,14 @@ class Zone {
 
   void* Allocate(size_t size);
 
+  // Allocates zero-filled array in current zone
+  template <class T>
+  static inline T* NewArray(size_t size) {
+    T* result = reinterpret_cast<T*>(current()->Allocate(sizeof(T) * size));
+    memset(result, 0, sizeof(T) * size);
+    return result;
+  }
+
   static Zone* current_;
   static inline Zone* current() { return current_; }
 
@@ -55,6 +55,12 @@ TEST_START("functional test")
     assert(result == NULL);
   })
 
+  FUN_TEST("a(b, c, d, e, f, g) {\n"
+           "return b + c * 10 + d * 100 + e * 1000 + f * 10000 + g * 100000\n"
+           "}\nreturn a(6, 5, 4, 3, 2, 1) + a(5, 4, 3, 2, 1)", {
+    assert(HValue::As<HNumber>(result)->value() == 708642);
+  })
+
   FUN_TEST("b() {\nreturn 1\n}\na(c) {\nreturn c()\n}\nreturn a(b)", {
     assert(HValue::As<HNumber>(result)->value() == 1);
   })
@@ -63,6 +69,21 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 1);
   })
 
+  // Tail calls
+  FUN_TEST("a(n, acc) { scope a\nif (n == 0) { scope acc\nreturn acc }\n"
+           "return a(acc + 2, n - 1) }\nreturn a(0, 1000000)", {
+    assert(HValue::As<HNumber>(result)->value() == 2000000);
+  })
+
+  FUN_TEST("even = nil\nodd = nil\n"
+           "even(n) { scope odd\nif (n == 0) { return true }\n"
+           "return odd(n - 1) }\n"
+           "odd(n) { scope even\nif (n == 0) { return false }\n"
+           "return even(n - 1) }\n"
+           "return even(1000001)", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
   // Context slots
   FUN_TEST("b = 13589\na() { scope b }\nreturn b", {
     assert(HValue::As<HNumber>(result)->value() == 13589);
@@ -76,6 +97,27 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 1);
   });
 
+  FUN_TEST("a(b, c, d, e, f) { return () { scope b, f\nreturn b * 10 + f } }\n"
+           "return a(1, 2, 3, 4, 5)()", {
+    assert(HValue::As<HNumber>(result)->value() == 51);
+  })
+
+  // Functions without context variables don't allocate contexts
+  FUN_TEST("a() { y = 3\nreturn () { return () { scope y\ny = y + 1\n"
+           "return y } } }\nf = a()()\nf()\nreturn f()", {
+    assert(HValue::As<HNumber>(result)->value() == 5);
+  })
+
+  // Outer contexts used repeatedly are cached in stack slots
+  FUN_TEST("a() { x = 1\nreturn b() { scope x\ny = 2\n"
+           "return c() { scope x, y\nz = 3\n"
+           "return d(n) { scope x, y, z\ni = 0\ns = 0\n"
+           "while (i < n) { scope i, s, x, y, z\ns = s + x + y + z\ni++ }\n"
+           "x = x + 1\nreturn s } } } }\n"
+           "g = a()()\nf = g()\nreturn f(10) + f(10) * 100", {
+    assert(HValue::As<HNumber>(result)->value() == 7060);
+  })
+
   // Binary ops
   FUN_TEST("return 1 + 2 * 3 + 4 / 2 + (3 | 2) + (5 & 3) + (3 ^ 2)", {
     assert(HValue::As<HNumber>(result)->value() == 14);
@@ -94,6 +136,44 @@ TEST_START("functional test")
     assert(result == NULL);
   })
 
+  FUN_TEST("return nil - 1 + ('3' * '4') + (nil | 3) + ('12' >> 1)", {
+    assert(HValue::As<HNumber>(result)->value() == 20);
+  })
+
+  // Small integers mixed with other values
+  FUN_TEST("a = true\nreturn 1 + a", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  FUN_TEST("f(a) {\nreturn 1 + a\n}\nreturn f('x')", {
+    assert(result == NULL);
+  })
+
+  FUN_TEST("a = {}\nreturn 1 + a", {
+    assert(result == NULL);
+  })
+
+  FUN_TEST("a = {}\nx = 2 * a\nreturn x == x", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("f(a) {\nreturn a - 1\n}\nreturn f(false) + f('3') * 10", {
+    assert(HValue::As<HNumber>(result)->value() == 19);
+  })
+
+  // Arithmetic on strings that aren't numbers gives NaN
+  FUN_TEST("x = 'x' * 2\nreturn x == x", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("x = '12a' - '2'\ny = 'x' % 5\nreturn x == x || y == y", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return '2.5' * '4' - '1'", {
+    assert(HValue::As<HNumber>(result)->value() == 9);
+  })
+
   // Unary ops
   FUN_TEST("a = 1\nreturn ++a", {
     assert(HValue::As<HNumber>(result)->value() == 2);
@@ -130,6 +210,13 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 8);
   })
 
+  FUN_TEST("a = { x: 1 }\ni = 0\nwhile (i < 3000) { scope a, i\na[i] = i\ni++ }\n"
+           "i = 0\nj = 0\nwhile (i < 3000) { scope a, i, j\n"
+           "a[i] = a[i] + 1\nj = j + a[i]\ni++ }\n"
+           "return j + a.x + a[3000]", {
+    assert(HValue::As<HNumber>(result)->value() == 4501501);
+  })
+
   FUN_TEST("a = { a: 1, b: 2 }\nreturn a.c", {
     assert(result == NULL);
   })
@@ -146,16 +233,65 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 2);
   })
 
+  // Interned keys
+  FUN_TEST("a = { 'key': 1, key: 2 }\nreturn a.key + a['key']", {
+    assert(HValue::As<HNumber>(result)->value() == 4);
+  })
+
+  FUN_TEST("a = { x: 1 }\nb = { x: 2 }\nreturn a.x + b.x + a.y", {
+    assert(HValue::As<HNumber>(result)->value() == 3);
+  })
+
+  // Literals with the same source share root slot
+  FUN_TEST("a = { 'id': 0.5, id2: 'id' }\nb = 'id'\n"
+           "return a[b] + a[a.id2] + a['id'] + 0.5", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  FUN_TEST("f() { a = 0.5\ni = 0\n"
+           "while (i < 10) { scope a, i\na = a + 0.5\ni++\n}\n"
+           "return a }\n"
+           "return f() + f() + 0.5", {
+    assert(HValue::As<HNumber>(result)->value() == 11.5);
+  })
+
   // Numeric keys
   FUN_TEST("a = { 1: 2, 2: 3}\nreturn a[1] + a[2] + a['1'] + a['2']", {
     assert(HValue::As<HNumber>(result)->value() == 10);
   });
 
+  FUN_TEST("a = {}\ni = 20\nwhile (i--) { scope a, i\na[i] = i }\n"
+           "i = 20\nj = 0\nwhile (i--) { scope a, i, j\nj = j + a[i] }\n"
+           "return j + a[20]", {
+    assert(HValue::As<HNumber>(result)->value() == 190);
+  })
+
   FUN_TEST("a = { 1.1: 2, 2.2: 3}\n"
            "return a[1.1] + a[2.2] + a['1.1'] + a['2.2']", {
     assert(HValue::As<HNumber>(result)->value() == 10);
   });
 
+  // Boilerplate maps
+  FUN_TEST("i = 0\nj = 0\n"
+           "while (i < 100) { scope i, j\n"
+           "a = { x: i, y: { z: i, x: 1 }, x: i + 1, w: 'w' }\n"
+           "a.q = 2\nj = j + a.x + a.y.z + a.y.x + a.q\ni++\n}\n"
+           "return j", {
+    assert(HValue::As<HNumber>(result)->value() == 10300);
+  })
+
+  // Small objects keep properties inline until they outgrow them
+  FUN_TEST("a = { x: 1, y: 2, x: 3 }\na.z = 4\na.w = 5\na.v = 6\na.u = 7\n"
+           "return a.x + a.y + a.z + a.w + a.v + a.u + a.t", {
+    assert(HValue::As<HNumber>(result)->value() == 27);
+  })
+
+  FUN_TEST("a = { a: 1, b: 2, c: 3, d: 4, e: 5, f: 6, g: 7, h: 8, i: 9,"
+           "j: 10, k: 11, l: 12, m: 13, n: 14, o: 15, p: 16, q: 17 }\n"
+           "return a.a + a.h + a.p + a.q", {
+    assert(HValue::As<HNumber>(result)->value() == 42);
+  })
+
   // Arrays
   FUN_TEST("a = [ 1, 2, 3, 4 ]\nreturn a[0] + a[1] + a[2] + a[3]", {
     assert(HValue::As<HNumber>(result)->value() == 10);
@@ -165,11 +301,28 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 4);
   })
 
+  // Index keys share root slots with each other and with literals
+  FUN_TEST("a = [ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,"
+           " 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,"
+           " 31, 32, 33, 34, 35, 36, 37, 38, 39 ]\n"
+           "b = [ 7, 8 ]\ni = 0\ns = 0\n"
+           "while (i < a.length) { scope a, i, s\n"
+           "if (a[i] == i) { scope s\ns++ }\ni++ }\n"
+           "return s + b[0] + b[1] + b.length + a.length", {
+    assert(HValue::As<HNumber>(result)->value() == 97);
+  })
+
   // Global lookup
   FUN_TEST("scope a\na = 1\nreturn a", {
     assert(HValue::As<HNumber>(result)->value() == 1);
   })
 
+  FUN_TEST("scope a, b, c\na = 1\n"
+           "f() { scope a, b\nb = { x: a }\nreturn b.x + a }\n"
+           "c = f() + f()\nreturn c + b.x", {
+    assert(HValue::As<HNumber>(result)->value() == 5);
+  })
+
   // If
   FUN_TEST("if (true) {\n return 1\n} else {\nreturn 2\n}", {
     assert(HValue::As<HNumber>(result)->value() == 1);
@@ -206,6 +359,315 @@ TEST_START("functional test")
     assert(HValue::As<HNumber>(result)->value() == 10);
   })
 
+  FUN_TEST("i = 0\nwhile (i < 10) {scope i\ni++\n}\nreturn i", {
+    assert(HValue::As<HNumber>(result)->value() == 10);
+  })
+
+  FUN_TEST("i = 10\nj = 0\n"
+           "while (i >= 0 && j != 5) {scope i, j\ni--\nj++\n}\n"
+           "return i", {
+    assert(HValue::As<HNumber>(result)->value() == 5);
+  })
+
+  // Conditions
+  FUN_TEST("if (1 < 2 && 3 > 2) {\n return 1\n} else {\nreturn 2\n}", {
+    assert(HValue::As<HNumber>(result)->value() == 1);
+  })
+
+  FUN_TEST("if (1 > 2 || 2 <= 1) {\n return 1\n} else {\nreturn 2\n}", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  FUN_TEST("if (!0 && !nil) {\n return 1\n} else {\nreturn 2\n}", {
+    assert(HValue::As<HNumber>(result)->value() == 1);
+  })
+
+  FUN_TEST("if (0 - 1 < 0) {\n return 1\n} else {\nreturn 2\n}", {
+    assert(HValue::As<HNumber>(result)->value() == 1);
+  })
+
+  FUN_TEST("if (0.5) {\n return 1\n} else {\nreturn 2\n}", {
+    assert(HValue::As<HNumber>(result)->value() == 1);
+  })
+
+  // Comparison
+  FUN_TEST("return 1 < 2", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return 2 <= 1.5", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return 1 === 1.0", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("x = 0.0 / 0.0\nreturn x == x", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("x = 'ab'\nreturn x === 'ab'", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return 'abc' < 'abd'", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return 1 == '1'", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return 1 !== '1'", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  // Strings that aren't numbers are never equal to numbers
+  FUN_TEST("return 'x' == 72", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return '1x' != 1", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return 'x' < 100 || 'x' >= 0 || '' == 0", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return '2.5' > 2", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("a = {}\nreturn a == {}", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return nil == nil", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
+  FUN_TEST("return !(1 < 2)", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  FUN_TEST("return 0 || 5", {
+    assert(HValue::As<HNumber>(result)->value() == 5);
+  })
+
+  FUN_TEST("return nil && 4", {
+    assert(result == NULL);
+  })
+
+  // Type feedback
+  FEEDBACK_TEST("a = 1\nreturn a + 0.5 + (a + 2)",
+                "[@0 binop:double binop:double binop:smi]")
+  FEEDBACK_TEST("a = { x: 1 }\nreturn a.x + a.y.z",
+                "[@0 binop:generic member:object member:nil member:object]")
+  FEEDBACK_TEST("a = 1\nif (a) { a = 2 }\nif (a && nil) { a = 3 }\n"
+                "if (a < 2) { a = 4 }",
+                "[@0 cond:smi cond:smi|nil cond:- binop:smi]")
+  FEEDBACK_TEST("call(fn) { return fn() }\nf() { return 1 }\n"
+                "call(f)\ncall(f)",
+                "[@0 call:monomorphic call:monomorphic]"
+                "[@4 call:monomorphic][@26]")
+  FEEDBACK_TEST("call(fn) { return fn() }\nf() { return 1 }\n"
+                "g() { return 2 }\ncall(f)\ncall(g)",
+                "[@0 call:monomorphic call:monomorphic]"
+                "[@4 call:megamorphic][@26][@43]")
+
+  FUN_TEST("call(fn) { return fn() }\nf() { return 1 }\ng() { return 2 }\n"
+           "return call(f) + call(f) * 10 + call(g) * 100 + call(f) * 1000", {
+    assert(HValue::As<HNumber>(result)->value() == 1211);
+  })
+
+  // Optimizing compiler
+  FUN_TEST("sum(a, b) { return a + b }\n"
+           "run() { scope sum\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, sum\nr = sum(r, i)\ni++\n}\n"
+           "return r\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 1999000);
+  })
+
+  FUN_TEST("f(a) {\ns = 0.5\ni = 0\nn = a\n"
+           "while (i < n) { scope i, n, s\ns = s + i / 2\ni++\n}\n"
+           "return s\n}\n"
+           "run() { scope f\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, f\nr = f(10)\ni++\n}\n"
+           "return r\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 20.5);
+  })
+
+  FUN_TEST("f(a) { return a + 4611686018427387903 }\n"
+           "run() { scope f\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, f\nr = f(i)\ni++\n}\n"
+           "return r\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() ==
+           4611686018427387903.0 + 1999);
+  })
+
+  FUN_TEST("f(a, b) {\nif (a > b || b == nil) {\nreturn 1\n}\n"
+           "return !a && 2\n}\n"
+           "run() { scope f\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, f\n"
+           "r = f(i, nil) + f(1, i) * 10 + f(nil, 0) * 100\ni++\n}\n"
+           "return r\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 111);
+  })
+
+  // On-stack replacement
+  FUN_TEST("s = 0\ni = 0\nwhile (i < 300) { scope i, s\nj = 0\n"
+           "while (j < 100) { scope i, j, s\ns = s + i * j\nj++\n}\n"
+           "i++\n}\nreturn s", {
+    assert(HValue::As<HNumber>(result)->value() == 222007500);
+  })
+
+  FUN_TEST("x = 5\ni = 0\nwhile (i < 20000) { scope i, x\n"
+           "if (i == 15000) { scope i, x\nreturn i + x\n}\ni++\n}\n"
+           "return 0", {
+    assert(HValue::As<HNumber>(result)->value() == 15005);
+  })
+
+  FUN_TEST("f(n) {\ns = 0\ni = 0\nm = n\n"
+           "while (i < m) { scope i, m, s\ns = s + i\ni++\n}\n"
+           "return s + 0.5\n}\n"
+           "return f(30000)", {
+    assert(HValue::As<HNumber>(result)->value() == 449985000.5);
+  })
+
+  FEEDBACK_TEST("s = 0\ni = 0\nwhile (i < 10000) { scope i, s\n"
+                "s = s + i\ni++\n}\nreturn s",
+                "[@0 osr binop:smi binop:smi cond:- binop:smi]")
+
+  FEEDBACK_TEST("sum(a, b) { return a + b }\n"
+                "run() { scope sum\ni = 0\nr = 0\n"
+                "while (i < 2000) { scope i, r, sum\nr = sum(r, i)\ni++\n}\n"
+                "return r\n}\n"
+                "run()",
+                "[@0 call:monomorphic][@3 optimized binop:smi]"
+                "[@30 call:monomorphic binop:smi cond:- binop:smi]")
+
+  FEEDBACK_TEST("scope sq\nsq(x) { return x * x }\n"
+                "run() { scope sq\ni = 0\nt = 0\n"
+                "while (i < 10000) { scope i, sq, t\nt = t + sq(i)\ni++\n}\n"
+                "return t\n}\n"
+                "run()",
+                "[@0 call:monomorphic][@11 optimized binop:smi]"
+                "[@35 osr binop:smi call:monomorphic binop:smi cond:- "
+                "binop:smi]")
+
+  // Deoptimization
+  FUN_TEST("f(a, b) { return a + b }\n"
+           "run() { scope f\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, f\nr = r + f(i, 1)\ni++\n}\n"
+           "return r + f(1.5, 2)\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 2001003.5);
+  })
+
+  FUN_TEST("f(c, b, a) {\ni = 0\ns = 0.5\nt = 0\nk = 0\n"
+           "while (i < a) { scope i, s, a, b, t, c, k\n"
+           "k = i * c\ns = s + b\nif (i < 2) { scope i, s, t\nt = s\n}\n"
+           "i++\n}\n"
+           "return s + t * 1000\n}\n"
+           "run() { scope f\ni = 0\n"
+           "while (i < 2000) { scope i, f\nf(4, 0.5, 3)\ni++\n}\n"
+           "return f(4, 0.5, 2305843009213693952)\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 1502.5);
+  })
+
+  FUN_TEST("a() { x = 100000000000000\nreturn b() { scope x\ny = 2\n"
+           "return c() { scope x, y\nz = 3\n"
+           "return d(n) { scope x, y, z\ni = 0\ns = 0\n"
+           "while (i < n) { scope i, s, x, y, z\ns = s + x + y + z\ni++ }\n"
+           "return s } } } }\n"
+           "g = a()()\nf = g()\ni = 0\n"
+           "while (i < 1100) { scope i, f\nf(2)\ni++\n}\n"
+           "return f(50000)", {
+    assert(HValue::As<HNumber>(result)->value() == 5.0000000000002304e+18);
+  })
+
+  FUN_TEST("s = 1\ni = 0\nwhile (i < 50000) { scope i, s\n"
+           "s = s + 100000000000000\ni++\n}\nreturn s", {
+    assert(HValue::As<HNumber>(result)->value() == 5e18);
+  })
+
+  FEEDBACK_TEST("s = 1\ni = 0\nwhile (i < 50000) { scope i, s\n"
+                "s = s + 100000000000000\ni++\n}\nreturn s",
+                "[@0 deoptimized binop:smi|double binop:smi cond:- "
+                "binop:smi]")
+
+  // Objects that don't escape are materialized by deoptimization
+  FUN_TEST("f(n, a) {\np = { x: a, y: 2 }\nq = p\ni = 0\ns = 0\n"
+           "while (i < n) { scope i, s, p, n\ns = s + p.x * p.y\ni++\n}\n"
+           "return s + q.x + p.y * 100\n}\n"
+           "run() { scope f\ni = 0\nr = 0\n"
+           "while (i < 2000) { scope i, r, f\nr = f(i, 2)\ni++\n}\n"
+           "return r + f(1.5, 3)\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 10405.5);
+  })
+
+  FEEDBACK_TEST("f(n, a) {\np = { x: a, y: 2 }\ni = 0\ns = 0\n"
+                "while (i < n) { scope i, s, p, n\ns = s + p.x * p.y\ni++\n}\n"
+                "return s\n}\n"
+                "run() { scope f\ni = 0\n"
+                "while (i < 2000) { scope i, f\nf(i, 2)\ni++\n}\n"
+                "return f(1.5, 3)\n}\n"
+                "run()",
+                "[@0 call:monomorphic][@1 deoptimized binop:smi|double "
+                "binop:smi|double member:object member:object binop:smi "
+                "cond:- binop:smi]"
+                "[@112 call:monomorphic binop:smi cond:- binop:smi "
+                "call:monomorphic]")
+
+  // Inlining
+  FUN_TEST("max(a, b) {\nif (a > b) { scope a\nreturn a\n}\nreturn b\n}\n"
+           "run() { scope max\ni = 0\ns = 0\n"
+           "while (i < 10000) { scope i, s, max\ns = s + max(i, 5000)\ni++\n}\n"
+           "return s\n}\n"
+           "return run()", {
+    assert(HValue::As<HNumber>(result)->value() == 62497500);
+  })
+
+  FEEDBACK_TEST("max(a, b) {\nif (a > b) { scope a\nreturn a\n}\nreturn b\n}\n"
+                "run() { scope max\ni = 0\ns = 0\n"
+                "while (i < 10000) { scope i, s, max\n"
+                "s = s + max(i, 5000)\ni++\n}\n"
+                "return s\n}\n"
+                "return run()",
+                "[@0 call:monomorphic][@3 optimized cond:- binop:smi]"
+                "[@58 osr binop:smi call:monomorphic binop:smi cond:- "
+                "binop:smi]")
+
+  FUN_TEST("max(a, b) {\nif (a > b) { scope a\nreturn a\n}\nreturn b\n}\n"
+           "min(a, b) {\nif (a < b) { scope a\nreturn a\n}\nreturn b\n}\n"
+           "run(f) {\ni = 0\ns = 0\n"
+           "while (i < 10000) { scope i, s, f\ns = s + f(i, 5000)\ni++\n}\n"
+           "return s\n}\n"
+           "return run(max) + run(min) * 100000000", {
+    assert(HValue::As<HNumber>(result)->value() == 3749750062497500.0);
+  })
+
+  FUN_TEST("add = nil\nrun = nil\n"
+           "add(a, b) { return a + b }\n"
+           "k = 1\n"
+           "run(n) { scope add, k\ni = 0\ns = 0\n"
+           "while (i < n) { scope i, s, add, k\ns = add(s, k)\ni++\n}\n"
+           "return s\n}\n"
+           "j = 0\nt = 0\n"
+           "while (j < 1100) { scope j, t, run\nt = t + run(3)\nj++\n}\n"
+           "k = 0.5\n"
+           "return t + run(3)", {
+    assert(HValue::As<HNumber>(result)->value() == 3301.5);
+  })
+
   // Runtime errors
   FUN_TEST("() {}", {
     assert(s.CaughtException() == true);
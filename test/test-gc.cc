@@ -25,6 +25,58 @@ TEST_START("GC test")
     assert(HValue::As<HNumber>(result)->value() == 2);
   })
 
+  FUN_TEST("x = { abc : 'abc' }\n__$gc()\nx.abc = x.abc\nreturn x.abc", {
+    HString* str = HValue::As<HString>(result);
+    str = str;
+    assert(str->length() == 3);
+    assert(strncmp(str->value(), "abc", str->length()) == 0);
+  })
+
+  FUN_TEST("x = {}\ni = 0\nwhile (i < 100) { scope x, i\nx[i] = { y: i }\ni++ }\n"
+           "__$gc()\nx.z = 1\n__$gc()\nreturn x[99].y + x[0].y + x.z", {
+    assert(HValue::As<HNumber>(result)->value() == 100);
+  })
+
+  FUN_TEST("x = { a: { b: 1 } }\n__$gc()\nx.c = 2\nx.d = 3\nx.e = 4\n"
+           "x.f = 5\n__$gc()\nreturn x.a.b + x.c + x.f", {
+    assert(HValue::As<HNumber>(result)->value() == 8);
+  })
+
+  FUN_TEST("x = { y: 1, z: 2 }\nx.y = nil\n__$gc()\nreturn x.z", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  // Keys interned at runtime are moved or dropped by GC
+  FUN_TEST("a = {}\na[true] = 1\n__$gc()\nb = {}\nb[true] = 2\n__$gc()\n"
+           "return a[true] + b[true] * 10 + a['true'] * 100", {
+    assert(HValue::As<HNumber>(result)->value() == 121);
+  })
+
+  FUN_TEST("f() {\no = {}\no[false] = 1\nreturn o[false]\n}\nf()\n__$gc()\n"
+           "a = {}\na[false] = 2\n__$gc()\n"
+           "return a[false] + a['false'] * 10 + f() * 100", {
+    assert(HValue::As<HNumber>(result)->value() == 122);
+  })
+
+  FUN_TEST("f() {\no = {}\no[1000] = 1\nreturn o[1000]\n}\nf()\n__$gc()\n"
+           "a = {}\na[1000] = 2\na[0.5] = 3\n__$gc()\n"
+           "return a[1000] + a[0.5] * 10 + f() * 100", {
+    assert(HValue::As<HNumber>(result)->value() == 132);
+  })
+
+  // Functions cached by call sites
+  FUN_TEST("call(fn) { return fn() }\nf() { return 1 }\ng() { return 2 }\n"
+           "a = call(f)\n__$gc()\nb = call(f)\n__$gc()\nc = call(g)\n__$gc()\n"
+           "return a + b * 10 + c * 100 + call(f) * 1000", {
+    assert(HValue::As<HNumber>(result)->value() == 1211);
+  })
+
+  // Booleans
+  FUN_TEST("x = { y : true, z : false }\n__$gc()\n"
+           "if (x.z) {\nreturn false\n}\nreturn x.y", {
+    assert(HValue::As<HBoolean>(result)->is_true());
+  })
+
   // Inside function
   FUN_TEST("x = { y : 1 }\n"
            "a() {\nscope x\nx.y = 2\n__$gc()\nreturn x.y\n}\n"
@@ -63,4 +115,18 @@ TEST_START("GC test")
            "return a.x.y", {
     assert(HValue::As<HObject>(result) != NULL);
   })
+
+  // Heap numbers allocated in loop (GC happens on allocation)
+  FUN_TEST("i = 0\ns = 0.5\no = { x: 0.25 }\n"
+           "while (i < 1000000) {\nscope i, s, o\ns = s + o.x * 2.0\ni++\n}\n"
+           "return s + o.x", {
+    assert(HValue::As<HNumber>(result)->value() == 500000.75);
+  })
+
+  // Mutable box is moved by GC
+  FUN_TEST("i = 0\ns = 0.5\n"
+           "while (i < 3) {\nscope i, s\ns = s + 1.0\n__$gc()\ni++\n}\n"
+           "return s", {
+    assert(HValue::As<HNumber>(result)->value() == 3.5);
+  })
 TEST_END("GC test")
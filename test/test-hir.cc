@@ -0,0 +1,44 @@
+#include "test.h"
+#include <parser.h>
+#include <scope.h>
+#include <ast.h>
+#include <hir.h>
+
+TEST_START("hir test")
+  // Basic
+  HIR_TEST("a = 1\nreturn a + 2",
+           "[B0 i1=1 i2=2 i3=Add(i1,i2) Return(i3)]")
+  HIR_TEST("return !(1 < 2)",
+           "[B0 i1=1 i2=2 i3=Lt(i1,i2) i4=Not(i3) Return(i4)]")
+  HIR_TEST("return 1.5", "[B0 i1=1.5 Return(i1)]")
+  HIR_TEST("a = 1", "[B0 i0=nil Return(i0)]")
+
+  // Control flow
+  HIR_TEST("a = 1\nb = 2\nif (a) { scope a, b\na = a + b\n} else {"
+           " scope a, b\nb = a + b\n}\nreturn a + b",
+           "[B0 i1=1 i2=2 Branch(i1,B1,B2)] [B1 i4=Add(i1,i2) Goto(B3)] "
+           "[B2 i6=Add(i1,i2) Goto(B3)] "
+           "[B3 i8=Phi(i4,i1) i9=Phi(i2,i6) i10=Add(i8,i9) Return(i10)]")
+  HIR_TEST("a = 1\nreturn a && 2",
+           "[B0 i1=1 Branch(i1,B1,B5)] [B1 i3=2 Goto(B2)] [B5 Goto(B2)] "
+           "[B2 i5=Phi(i1,i3) Return(i5)]")
+
+  // Value numbering and dead code
+  HIR_TEST("a = 1\nb = 2\nc = a + b\nreturn a + b",
+           "[B0 i1=1 i2=2 i3=Add(i1,i2) Return(i3)]")
+  HIR_TEST("a = 1\nb = 2\nreturn (a + b) * (a + b)",
+           "[B0 i1=1 i2=2 i3=Add(i1,i2) i5=Mul(i3,i3) Return(i5)]")
+
+  // Loop invariants
+  HIR_TEST("i = 0\nn = 10\nwhile (i < n) { scope i, n\ni = i + n * 2\n}\n"
+           "return i",
+           "[B0 i1=0 i2=10 i8=2 i9=Mul(i2,i8) Goto(B1)] "
+           "[B1 i4=Phi(i1,i10) i6=Lt(i4,i2) Branch(i6,B2,B3)] "
+           "[B2 i10=Add(i4,i9) Goto(B1)] [B3 Return(i4)]")
+
+  // Objects that don't escape
+  HIR_TEST("p = { x: 1, y: 2 }\nreturn p.x + p.y",
+           "[B0 i1=1 i2=2 i6=Add(i1,i2) Return(i6)]")
+  HIR_TEST("p = { x: 1, y: 2, x: 3 }\nreturn p[\"x\"] + p.z",
+           "[B0 i0=nil i3=3 i7=Add(i3,i0) Return(i7)]")
+TEST_END("hir test")
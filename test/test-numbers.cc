@@ -54,4 +54,112 @@ TEST_START("numbers test")
            "4611686018427387904 - 4611686018427387904", {
     assert(HValue::As<HNumber>(result)->value() == -18446744073709551616.0);
   })
+
+  FUN_TEST("return 4611686018427387903 + 1", {
+    assert(HValue::As<HNumber>(result)->value() == 4611686018427387904.0);
+  })
+
+  FUN_TEST("return 3 * (0 - 4)", {
+    assert(HValue::As<HNumber>(result)->value() == -12);
+  })
+
+  // Division
+  FUN_TEST("return (0 - 7) / 2", {
+    assert(HValue::As<HNumber>(result)->value() == -3);
+  })
+
+  FUN_TEST("return 1 / 0", {
+    assert(HValue::As<HNumber>(result)->value() == 1.0 / 0.0);
+  })
+
+  // Nested expressions
+  FUN_TEST("return (1.5 + 2) * (3 - 0.5) + (1 + 2) * 0.5", {
+    assert(HValue::As<HNumber>(result)->value() == 10.25);
+  })
+
+  FUN_TEST("a = 1.5 * 2.0 + 0.5\nb = 2.5 * 2.0 + 0.5\nreturn a", {
+    assert(HValue::As<HNumber>(result)->value() == 3.5);
+  })
+
+  FUN_TEST("f(a) { return a * 2.5 }\nx = 0.5\nreturn x * 2 + f(3) * 2", {
+    assert(HValue::As<HNumber>(result)->value() == 16);
+  })
+
+  // Accumulators are updated in place, but their values never leak
+  FUN_TEST("sum = 0.5\nx = sum\nsum = sum + 1.0\nreturn x", {
+    assert(HValue::As<HNumber>(result)->value() == 0.5);
+  })
+
+  FUN_TEST("b = 1.5\nsum = b\nsum = sum + 1.0\nreturn b", {
+    assert(HValue::As<HNumber>(result)->value() == 1.5);
+  })
+
+  FUN_TEST("sum = 0.5\nsum = sum * 3.0\nsum = 0.5\nsum = sum + 1.0\n"
+           "return 0.5 + sum", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  FUN_TEST("o = {}\nsum = 0\ni = 0\n"
+           "while (i < 10) {scope o, sum, i\nsum = sum + 0.5\n"
+           "if (i == 4) {scope o, sum\no.x = sum\n}\ni++\n}\n"
+           "return o.x + sum", {
+    assert(HValue::As<HNumber>(result)->value() == 7.5);
+  })
+
+  // Modulo
+  FUN_TEST("return (0 - 7) % 3", {
+    assert(HValue::As<HNumber>(result)->value() == -1);
+  })
+
+  FUN_TEST("return 5 % 3 * 2", {
+    assert(HValue::As<HNumber>(result)->value() == 4);
+  })
+
+  FUN_TEST("return (0 - 5.5) % 2", {
+    assert(HValue::As<HNumber>(result)->value() == -1.5);
+  })
+
+  FUN_TEST("x = 7 % 0\nreturn x == x", {
+    assert(HValue::As<HBoolean>(result)->is_false());
+  })
+
+  // Bitwise ops and shifts work on int32 values
+  FUN_TEST("return 1 << 31", {
+    assert(HValue::As<HNumber>(result)->value() == -2147483648.0);
+  })
+
+  FUN_TEST("return (0 - 1) >>> 0", {
+    assert(HValue::As<HNumber>(result)->value() == 4294967295.0);
+  })
+
+  FUN_TEST("return (0 - 16) >> 2", {
+    assert(HValue::As<HNumber>(result)->value() == -4);
+  })
+
+  FUN_TEST("return 3000000000 | 0", {
+    assert(HValue::As<HNumber>(result)->value() == -1294967296);
+  })
+
+  FUN_TEST("return (0 - 2.7) | 0", {
+    assert(HValue::As<HNumber>(result)->value() == -2);
+  })
+
+  FUN_TEST("return 6 & 3.9", {
+    assert(HValue::As<HNumber>(result)->value() == 2);
+  })
+
+  FUN_TEST("return 100000000000000000000.5 ^ 0", {
+    assert(HValue::As<HNumber>(result)->value() == 1661992960);
+  })
+
+  FUN_TEST("return 1.0 / 0 | 0", {
+    assert(HValue::As<HNumber>(result)->value() == 0);
+  })
+
+  FUN_TEST("h = 5381\ni = 0\n"
+           "while (i < 100) {scope h, i\n"
+           "h = ((h << 5) + h) ^ i\nh = h >>> 0\ni++\n}\n"
+           "return h", {
+    assert(HValue::As<HNumber>(result)->value() == 344777157);
+  })
 TEST_END("numbers test")
@@ -29,6 +29,12 @@ TEST_START("parser test")
   PARSER_TEST("a * b + c - d * e",
               "[kAdd [kMul [a] [b]] [kSub [c] [kMul [d] [e]]]]")
   PARSER_TEST("(a + b) * c", "[kMul [kAdd [a] [b]] [c]]")
+  PARSER_TEST("a - (b + c)", "[kSub [a] [kAdd [b] [c]]]")
+  PARSER_TEST("a % b * c", "[kMul [kMod [a] [b]] [c]]")
+  PARSER_TEST("a << b + c >>> d",
+              "[kUShr [kShl [a] [kAdd [b] [c]]] [d]]")
+  PARSER_TEST("a < b && c == d || e",
+              "[kLOr [kLAnd [kLt [a] [b]] [kEq [c] [d]]] [e]]")
   PARSER_TEST("return 4611686018427387904 + 4611686018427387904 + "
               "4611686018427387904",
               "[kReturn [kAdd [4611686018427387904] "
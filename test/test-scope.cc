@@ -14,32 +14,40 @@ TEST_START("scope test")
              "[a @stack:0] [kFunction [a @stack:0] @[] [b @stack:0]]")
   SCOPE_TEST("a\r\n() { scope a\r\n a }",
              "[a @context[0]:0] "
-             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[1]:0]]")
+             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[0]:0]]")
   SCOPE_TEST("a\r\n() { { scope a\r\n a } }",
               "[a @context[0]:0] "
               "[kFunction (anonymous) @[] "
-              "[kBlock [kScopeDecl [a]] [a @context[1]:0]]]")
+              "[kBlock [kScopeDecl [a]] [a @context[0]:0]]]")
   SCOPE_TEST("a\r\n() { scope a \n () { scope a\r\n a } \r\n a }",
              "[a @context[0]:0] "
              "[kFunction (anonymous) @[] [kScopeDecl [a]] "
              "[kFunction (anonymous) @[] [kScopeDecl [a]] "
-             "[a @context[2]:0]] [a @context[1]:0]]")
+             "[a @context[0]:0]] [a @context[0]:0]]")
 
   // Global lookup
   SCOPE_TEST("scope a\r\na", "[kScopeDecl [a]] [a @context[-1]:0]")
   SCOPE_TEST("() {scope a\r\na}",
              "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[-1]:0]]")
+  SCOPE_TEST("scope a, b\r\na\r\nb\r\n() {scope b\r\nb}",
+             "[kScopeDecl [a] [b]] [a @context[-1]:0] [b @context[-1]:1] "
+             "[kFunction (anonymous) @[] [kScopeDecl [b]] [b @context[-1]:1]]")
 
   // Advanced context
   SCOPE_TEST("a\r\nb\r\n() {scope b\r\nb}\r\n() {scope a\r\na}",
              "[a @context[0]:0] [b @context[0]:1] "
-             "[kFunction (anonymous) @[] [kScopeDecl [b]] [b @context[1]:1]] "
-             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[1]:0]]")
+             "[kFunction (anonymous) @[] [kScopeDecl [b]] [b @context[0]:1]] "
+             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[0]:0]]")
   SCOPE_TEST("a\r\nb\r\n() { () {scope b\r\nb} }\r\n() {scope a\r\na}",
              "[a @context[0]:0] [b @context[0]:1] "
              "[kFunction (anonymous) @[] [kFunction (anonymous) @[] "
-             "[kScopeDecl [b]] [b @context[2]:1]]] "
-             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[1]:0]]")
+             "[kScopeDecl [b]] [b @context[0]:1]]] "
+             "[kFunction (anonymous) @[] [kScopeDecl [a]] [a @context[0]:0]]")
+  SCOPE_TEST("a\r\n() { b\r\n() { scope a, b\r\na + b } }",
+             "[a @context[0]:0] "
+             "[kFunction (anonymous) @[] [b @context[0]:0] "
+             "[kFunction (anonymous) @[] [kScopeDecl [a] [b]] "
+             "[kAdd [a @context[1]:0] [b @context[0]:0]]]]")
 
   // While
   SCOPE_TEST("i = 1\nj = 1\n"
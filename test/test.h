@@ -61,6 +61,34 @@
       block\
     }
 
+#define FEEDBACK_TEST(code, expected)\
+    {\
+      Zone z;\
+      char out[1024];\
+      Script s;\
+      s.Compile(code, strlen(code));\
+      s.Run();\
+      s.PrintFeedback(out, 1000);\
+      assert(strcmp(expected, out) == 0);\
+    }
+
+#define HIR_TEST(code, expected)\
+    {\
+      Zone z;\
+      char out[1024];\
+      Heap heap(2 * 1024 * 1024);\
+      Parser p(code, strlen(code));\
+      AstNode* ast = p.Execute();\
+      Scope::Analyze(ast);\
+      HIRGen hir(&heap, ast);\
+      bool built = hir.Build();\
+      assert(built);\
+      hir.Optimize();\
+      hir.Print(out, 1000);\
+      assert(strcmp(expected, out) == 0);\
+      built = built;\
+    }
+
 #define BENCH_START(name, num)\
     timeval __bench_##name##_start;\
     gettimeofday(&__bench_##name##_start, NULL);